@@ -0,0 +1,368 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "alloc_count.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/sensors.h"
+#include "sensors-c++/aggregate.h"
+#include "sensors-c++/async.h"
+#include "sensors-c++/change_filter.h"
+#include "sensors-c++/history.h"
+#include "sensors-c++/sampler.h"
+#include "sensors-c++/snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace sensors;
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+
+struct options
+{
+    std::optional<fake_hwmon::layout> fake;
+    std::string root;
+    bool native = false;
+    std::string filter;
+    // Time to spend on each case, divided over the mean and percentile passes
+    double seconds = 0.5;
+};
+
+[[noreturn]] void usage(char const* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s [--fake CHIPS[,FEATURES[,SUBFEATURES]] | --root SYSFS | --native] [--filter TEXT] [--time SECONDS]\n"
+        "\n"
+        "Benchmarks the library on the default context, unless given a synthetic tree to\n"
+        "generate or a sysfs root to use with the native backend. --native uses the\n"
+        "native backend on /sys. Writes are only measured on synthetic trees.\n", program);
+    std::exit(2);
+}
+
+// CHIPS[,FEATURES[,SUBFEATURES]], each a number and at least one chip
+std::optional<fake_hwmon::layout> parse_layout(std::string_view text)
+{
+    fake_hwmon::layout l;
+    for (auto field : {&l.chips, &l.features, &l.subfeatures}) {
+        auto const [end, error] = std::from_chars(text.data(), text.data() + text.size(), *field);
+        if (error != std::errc{})
+            return {};
+        text.remove_prefix(end - text.data());
+        if (text.empty())
+            break;
+        if (text.front() != ',')
+            return {};
+        text.remove_prefix(1);
+    }
+    if (!text.empty() || !l.chips)
+        return {};
+    return l;
+}
+
+options parse_options(int argc, char* argv[])
+{
+    options o;
+    for (int i = 1; i < argc; ++i) {
+        auto const arg = std::string_view{argv[i]};
+        auto const value = [&]{
+            if (++i == argc)
+                usage(argv[0]);
+            return argv[i];
+        };
+        if (arg == "--fake") {
+            o.fake = parse_layout(value());
+            if (!o.fake)
+                usage(argv[0]);
+        } else if (arg == "--root") {
+            o.root = value();
+        } else if (arg == "--native") {
+            o.native = true;
+        } else if (arg == "--filter") {
+            o.filter = value();
+        } else if (arg == "--time") {
+            auto const text = value();
+            char* end;
+            o.seconds = std::strtod(text, &end);
+            if (end == text || *end || !std::isfinite(o.seconds) || o.seconds <= 0)
+                usage(argv[0]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    return o;
+}
+
+// Keep the compiler from optimising away a result
+template<typename T>
+void keep(T const& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+double elapsed_ns(clock_type::time_point start, clock_type::time_point end)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+class runner
+{
+public:
+    explicit runner(options const& o) : m_options{o}
+    {
+        // Cost of reading the clock, subtracted from every timed operation
+        std::vector<double> overhead(10001);
+        for (auto& t : overhead) {
+            auto const start = clock_type::now();
+            t = elapsed_ns(start, clock_type::now());
+        }
+        std::nth_element(overhead.begin(), overhead.begin() + overhead.size() / 2, overhead.end());
+        m_clock_overhead = overhead[overhead.size() / 2];
+
+        std::printf("%-36s %9s %10s %10s %9s %9s %9s\n", "case", "ops", "ns/op", "allocs/op", "p50", "p99", "p999");
+    }
+
+    // Time op(i) for i = 0, 1, ... Cases with no objects to work on are
+    // skipped.
+    template<typename Op>
+    void run(char const* name, std::size_t objects, Op const& op)
+    {
+        if (!m_options.filter.empty() && !std::strstr(name, m_options.filter.c_str()))
+            return;
+        if (!objects) {
+            std::printf("%-36s (nothing to measure)\n", name);
+            return;
+        }
+
+        // Warm up every object once, so that one-time costs such as opening
+        // files stay out of the results, then estimate the number of operations
+        // that fit in the time budget
+        for (std::size_t i = 0; i < objects; ++i)
+            op(i);
+        auto const budget = m_options.seconds * 1e9 / 2;
+        std::size_t calibration = 0;
+        auto const start = clock_type::now();
+        while (elapsed_ns(start, clock_type::now()) < budget / 10)
+            op(calibration++);
+        auto const per_op = elapsed_ns(start, clock_type::now()) / calibration;
+        auto const count = std::clamp<std::size_t>(budget / std::max(per_op, 1.0), 100, 10000000);
+
+        // Mean time and allocations, without timing every operation
+        m_samples.resize(count);
+        auto const allocations = allocation_count();
+        auto const mean_start = clock_type::now();
+        for (std::size_t i = 0; i < count; ++i)
+            op(i);
+        auto const mean = elapsed_ns(mean_start, clock_type::now()) / count;
+        auto const allocs = static_cast<double>(allocation_count() - allocations) / count;
+
+        // Distribution of single operations
+        for (std::size_t i = 0; i < count; ++i) {
+            auto const op_start = clock_type::now();
+            op(i);
+            m_samples[i] = std::max(0.0, elapsed_ns(op_start, clock_type::now()) - m_clock_overhead);
+        }
+        std::sort(m_samples.begin(), m_samples.end());
+        auto const percentile = [&](double p) { return m_samples[std::min(count - 1, std::size_t(p * count))]; };
+
+        std::printf("%-36s %9zu %10.1f %10.2f %9.0f %9.0f %9.0f\n", name, count, mean, allocs,
+                    percentile(0.5), percentile(0.99), percentile(0.999));
+    }
+
+private:
+    options const& m_options;
+    double m_clock_overhead;
+    std::vector<double> m_samples;
+};
+
+char const* engine_name(read_engine engine)
+{
+    switch (engine) {
+    case read_engine::io_uring:
+        return "io_uring";
+    case read_engine::per_bus:
+        return "per_bus";
+    default:
+        return "sync";
+    }
+}
+
+} // anonymous namespace
+
+// Measures the library's enumeration, lookup, read and write paths separately
+// and reports the mean time and allocations per operation and the percentiles
+// of single operations in nanoseconds, after subtracting the cost of reading
+// the clock
+int main(int argc, char* argv[])
+{
+    auto const o = parse_options(argc, argv);
+
+    std::unique_ptr<fake_hwmon> tree;
+    std::unique_ptr<context> own;
+    if (o.fake) {
+        tree = std::make_unique<fake_hwmon>(*o.fake);
+        own = std::make_unique<context>(backend::native, std::string_view{}, tree->root());
+    } else if (!o.root.empty() || o.native) {
+        own = std::make_unique<context>(backend::native, std::string_view{}, o.root.empty() ? "/sys" : o.root);
+    }
+    auto& ctx = own ? *own : default_context();
+
+    // The objects the cases cycle through
+    auto const chips = ctx.get_detected_chips();
+    std::vector<feature> features;
+    std::vector<subfeature> subfeatures, readable, writable;
+    std::vector<std::string> chip_paths, feature_paths, subfeature_paths;
+    for (auto const& chip : chips) {
+        chip_paths.emplace_back(chip.path());
+        for (auto const& feat : chip.features()) {
+            features.push_back(feat);
+            feature_paths.push_back(std::string{chip.path()} + '/' + std::string{feat.name()});
+            for (auto const& sub : feat.subfeatures()) {
+                subfeatures.push_back(sub);
+                subfeature_paths.push_back(std::string{chip.path()} + '/' + std::string{sub.name()});
+                if (sub.readable())
+                    readable.push_back(sub);
+                if (sub.writable() && tree)
+                    writable.push_back(sub);
+            }
+        }
+    }
+    std::printf("%s backend%s%s: %zu chips, %zu features, %zu subfeatures\n\n",
+                own ? "native" : "default", o.root.empty() && !tree ? "" : " on ",
+                tree ? tree->root().c_str() : o.root.c_str(), chips.size(), features.size(), subfeatures.size());
+
+    // Create these before any attribute files are opened, which may use up the
+    // limit on open files for large trees
+    std::vector<snapshot> snapshots;
+    snapshots.emplace_back(readable, read_engine::sync);
+    if (snapshots.emplace_back(readable, read_engine::io_uring).engine() != read_engine::io_uring)
+        snapshots.pop_back();
+    if (snapshots.emplace_back(readable, read_engine::per_bus).engine() != read_engine::per_bus)
+        snapshots.pop_back();
+    sampler s;
+    for (auto const& sub : readable)
+        s.add(sub, std::chrono::milliseconds{100});
+
+    runner r {o};
+    auto const at = [](auto const& objects, std::size_t i) -> auto const& { return objects[i % objects.size()]; };
+
+    r.run("get_detected_chips()", 1, [&](std::size_t) { keep(ctx.get_detected_chips().size()); });
+    if (!chips.empty()) {
+        chip_pattern const pattern {std::string{chips.front().prefix()} + "-*"};
+        r.run("get_detected_chips(pattern)", 1, [&](std::size_t) { keep(ctx.get_detected_chips(pattern).size()); });
+    }
+    r.run("detected_chips()", 1, [&](std::size_t) { keep(ctx.detected_chips().size()); });
+    r.run("chip_name::features()", chips.size(), [&](std::size_t i) { keep(at(chips, i).features().size()); });
+    r.run("chip_name::feature_range()", chips.size(), [&](std::size_t i) { keep(at(chips, i).feature_range().size()); });
+    r.run("feature::subfeatures()", features.size(), [&](std::size_t i) { keep(at(features, i).subfeatures().size()); });
+    r.run("feature::subfeature_range()", features.size(), [&](std::size_t i) {
+        keep(at(features, i).subfeature_range().size());
+    });
+    r.run("feature::subfeature(input)", features.size(), [&](std::size_t i) {
+        keep(at(features, i).subfeature(subfeature_type::input).has_value());
+    });
+    r.run("chip_name(path)", chips.size(), [&](std::size_t i) { keep(chip_name{ctx, at(chip_paths, i)}.address()); });
+    r.run("feature(path)", features.size(), [&](std::size_t i) { keep(feature{ctx, at(feature_paths, i)}.number()); });
+    r.run("subfeature(path)", subfeatures.size(), [&](std::size_t i) {
+        keep(subfeature{ctx, at(subfeature_paths, i)}.number());
+    });
+    r.run("feature::label()", features.size(), [&](std::size_t i) { keep(at(features, i).label().size()); });
+    r.run("chip_name::name()", chips.size(), [&](std::size_t i) { keep(at(chips, i).name().size()); });
+    r.run("subfeature::read()", readable.size(), [&](std::size_t i) {
+        double value = 0;
+        at(readable, i).try_read(value);
+        keep(value);
+    });
+    r.run("subfeature::write()", writable.size(), [&](std::size_t i) {
+        keep(at(writable, i).try_write(42).value());
+    });
+
+    // Round trip of one read on the reader's threads, waited for by spinning
+    struct flagged : async_reader::operation
+    {
+        std::atomic<bool> done {false};
+    };
+    for (auto engine : {read_engine::sync, read_engine::io_uring}) {
+        async_reader reader {engine};
+        if (reader.engine() != engine)
+            continue;
+        auto const name = std::string{"async_reader::read() "} + engine_name(engine);
+        r.run(name.c_str(), readable.size(), [&](std::size_t i) {
+            flagged op;
+            op.complete = [](async_reader::operation& o) {
+                static_cast<flagged&>(o).done.store(true, std::memory_order_release);
+            };
+            reader.read(at(readable, i), op);
+            while (!op.done.load(std::memory_order_acquire))
+                ;
+            keep(op.value);
+        });
+    }
+
+    for (auto& snap : snapshots) {
+        auto const name = std::string{"snapshot::refresh() "} + engine_name(snap.engine())
+            + ", " + std::to_string(snap.size()) + " values";
+        r.run(name.c_str(), snap.size() ? 1 : 0, [&](std::size_t) { snap.refresh(); });
+    }
+
+    history h {600};
+    for (int i = 0; i < 1000; ++i)
+        h.push(history::clock::time_point{std::chrono::seconds{i}}, i);
+    r.run("history::range(), 60 of 600", 1, [&](std::size_t i) {
+        auto const from = history::clock::time_point{std::chrono::seconds{400 + i % 500}};
+        keep(h.range(from, from + std::chrono::seconds{60}).size());
+    });
+
+    std::vector<double> values(600);
+    for (std::size_t i = 0; i < values.size(); ++i)
+        values[i] = 40 + (i * 7919 % 600) / 100.0;
+    for (auto [isa, name] : {std::pair{instruction_set::scalar, "aggregate() scalar, 600 values"},
+                             std::pair{instruction_set::sse2, "aggregate() sse2, 600 values"},
+                             std::pair{instruction_set::avx2, "aggregate() avx2, 600 values"}}) {
+        if (isa <= native_instruction_set())
+            r.run(name, 1, [&](std::size_t) { keep(aggregate(values.data(), values.size(), isa).stddev); });
+    }
+
+    // One in a hundred values moves past the deadband on every update
+    std::vector<double> sweep(5000, 40);
+    change_filter filter {sweep.size()};
+    filter.set_deadband(0.5);
+    filter.update(sweep.data(), nullptr, change_filter::clock::now());
+    r.run("change_filter::update(), 5000 values", 1, [&](std::size_t i) {
+        for (std::size_t j = i % 100; j < sweep.size(); j += 100)
+            sweep[j] += i % 2 ? 1 : -1;
+        keep(filter.update(sweep.data(), nullptr, change_filter::clock::time_point{}));
+    });
+
+    s.start();
+    r.run("sampler::latest()", s.size(), [&](std::size_t i) { keep(s.latest(i % s.size()).value); });
+    s.stop();
+    return 0;
+}
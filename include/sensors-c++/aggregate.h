@@ -0,0 +1,68 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_AGGREGATE_H
+#define LIBSENSORS_CPP_AGGREGATE_H
+
+#include "history.h"
+
+#include <cstddef>
+
+namespace sensors {
+
+// Statistics of a series of values. The standard deviation is that of the
+// values themselves, not an estimate of a population's. All members but count
+// are NaN if there are no values.
+struct window_statistics
+{
+    std::size_t count;
+    double min;
+    double max;
+    double mean;
+    double stddev;
+};
+
+// Instruction sets the aggregate kernels are written for
+enum class instruction_set {
+    scalar,
+    sse2,
+    avx2
+};
+
+// The best instruction set this processor supports, which aggregate() uses
+instruction_set native_instruction_set();
+
+// Compute the statistics of values in one pass, e.g. over a column of a
+// snapshot or a segment of a history. The sums are taken relative to the first
+// value, which keeps the deviation accurate for values far from zero.
+window_statistics aggregate(double const* values, std::size_t count);
+
+// The same with a specific instruction set, or the best supported one if this
+// processor does not support it
+window_statistics aggregate(double const* values, std::size_t count, instruction_set isa);
+
+// Statistics of the values of a history window, or of a history's entries with
+// from <= time < to
+window_statistics aggregate(history::window const& w);
+window_statistics aggregate(history const& h, history::clock::time_point from, history::clock::time_point to);
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_AGGREGATE_H
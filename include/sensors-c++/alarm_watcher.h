@@ -0,0 +1,134 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_ALARM_WATCHER_H
+#define LIBSENSORS_CPP_ALARM_WATCHER_H
+
+#include "sensors.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <thread>
+
+namespace sensors {
+
+class sysfs_attribute;
+
+// Whether a subfeature type is an alarm or fault flag, e.g. alarm, crit_alarm
+// or fault
+bool is_alarm(subfeature_type type);
+
+// Watches alarm subfeatures on a background thread and reports when they change.
+// Many drivers call sysfs_notify() when an alarm attribute changes, which wakes
+// the thread through epoll(7) with EPOLLPRI, so that the change is reported
+// right away. As there is no telling which drivers do, every subfeature is also
+// read once per polling period. The watcher opens the files it watches itself,
+// so that other reads of the same subfeatures cannot consume a notification.
+class alarm_watcher
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct event
+    {
+        // Index returned by add()
+        std::size_t index;
+        // The new value, or the last one read successfully if error is not 0
+        double value;
+        // 0 on success or a negative libsensors error code
+        int error;
+        clock::time_point time;
+    };
+
+    // Called on the watcher thread for every change, which must not throw
+    using callback = std::function<void(event const&)>;
+
+    // Throws std::logic_error if the period is not positive, or a
+    // sensors::error if the timer or event queue could not be created
+    explicit alarm_watcher(clock::duration period = std::chrono::seconds{1});
+    ~alarm_watcher();
+
+    alarm_watcher(alarm_watcher const&) = delete;
+    alarm_watcher& operator=(alarm_watcher const&) = delete;
+
+    // Watch a subfeature, usually an alarm, and return its index. Throws
+    // std::logic_error if the watcher is running or the subfeature is not
+    // readable.
+    std::size_t add(sensors::subfeature const& sub, callback on_change);
+
+    // Watch every readable alarm subfeature of every chip detected in a context,
+    // and return their number
+    std::size_t add_alarms(context const& ctx, callback const& on_change);
+
+    std::size_t size() const;
+
+    // The subfeature of an index
+    sensors::subfeature const& subfeature(std::size_t index) const;
+
+    // Whether changes of subfeature index can wake the thread, rather than only
+    // being found by polling, i.e. whether its file supports EPOLLPRI. Files
+    // outside sysfs and those read through libsensors do not.
+    bool notifies(std::size_t index) const;
+
+    // Start or stop the watcher thread. start() reads every subfeature first,
+    // which gives the state that changes are reported against.
+    void start();
+    void stop();
+    bool running() const;
+
+    // The last value of subfeature index read successfully. Safe to call from
+    // any thread.
+    double value(std::size_t index) const;
+
+private:
+    struct entry
+    {
+        entry(sensors::subfeature const& sub, callback on_change);
+        ~entry();
+
+        sensors::subfeature subfeature;
+        sysfs_attribute const& attribute;
+        callback on_change;
+        // The watcher's own descriptor of the file, or -1 if it is read
+        // through the attribute
+        int fd = -1;
+        bool notifies = false;
+        std::atomic<double> value {0};
+        int error = 0;
+    };
+
+    void run();
+    void check(std::size_t index);
+    static int read(entry const& e, double& value);
+
+    std::deque<entry> m_entries;
+    clock::duration const m_period;
+    std::thread m_thread;
+    int m_epoll;
+    int m_timer;
+    int m_wakeup;
+};
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_ALARM_WATCHER_H
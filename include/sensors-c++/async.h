@@ -0,0 +1,90 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_ASYNC_H
+#define LIBSENSORS_CPP_ASYNC_H
+
+#include "sensors.h"
+#include "snapshot.h"
+
+#include <memory>
+
+namespace sensors {
+
+class sysfs_attribute;
+
+// Reads subfeatures without blocking the threads that start the reads. With
+// read_engine::io_uring, reads are submitted to an io_uring instance whose
+// completions are handled by a thread of the reader, and the kernel carries out
+// reads that take a while in parallel. Otherwise, and for reads that go through
+// libsensors, an I/O thread of the reader does the reads one after another.
+// Should submitting to the ring fail, the I/O thread takes over all reads from
+// then on. Either way only the code waiting for a slow read waits for it.
+//
+// <sensors-c++/coroutine.h> builds co_await-able reads on this class.
+class async_reader
+{
+public:
+    // A read in progress, which must stay in place until it completes
+    struct operation
+    {
+        // Called on a thread of the reader once value and error are set. It may
+        // start new reads, but must not throw.
+        void (*complete)(operation& op) = nullptr;
+        // Left unchanged if the read fails
+        double value = 0;
+        // 0 on success or a negative libsensors error code
+        int error = 0;
+
+    private:
+        friend async_reader;
+
+        sysfs_attribute const* attribute = nullptr;
+        operation* next = nullptr;
+        char buffer[64];
+    };
+
+    // Start the reader's threads. Uses read_engine::sync unless io_uring is
+    // requested and available.
+    explicit async_reader(read_engine engine = read_engine::io_uring);
+
+    // Waits for the reads in progress to complete, including those that their
+    // completions start. No new reads may be started meanwhile otherwise.
+    ~async_reader();
+
+    async_reader(async_reader const&) = delete;
+    async_reader& operator=(async_reader const&) = delete;
+
+    read_engine engine() const;
+
+    // Start reading a subfeature and call op.complete when done. Safe to call
+    // from any thread. Opening the subfeature's file on its first read is done
+    // by the calling thread. op refers to the subfeature's record, so the
+    // context of sub must exist until op completes.
+    void read(sensors::subfeature const& sub, operation& op);
+
+private:
+    struct state;
+    std::unique_ptr<state> const m_state;
+};
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_ASYNC_H
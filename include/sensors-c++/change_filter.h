@@ -0,0 +1,116 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_CHANGE_FILTER_H
+#define LIBSENSORS_CPP_CHANGE_FILTER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace sensors {
+
+class snapshot;
+
+// Decides which entries of a series of reads are worth passing on, such as the
+// values of a snapshot after each refresh(). An entry has changed if it differs
+// from the value last passed on by more than its deadband, if its error code
+// differs, or if it has not been passed on for the heartbeat interval. The
+// result is a bitmask with one bit per entry, so it costs a few cache lines to
+// go through even for thousands of entries. Nothing is allocated after
+// construction.
+class change_filter
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Filter for size entries, with no deadband and no heartbeat, so that every
+    // different value counts as a change. Every entry changes on the first
+    // update().
+    explicit change_filter(std::size_t size);
+    ~change_filter();
+
+    change_filter(change_filter const&) = delete;
+    change_filter& operator=(change_filter const&) = delete;
+
+    std::size_t size() const { return m_size; }
+
+    // Treat a value as unchanged while it differs from the last one passed on
+    // by no more than the larger of absolute and relative times the magnitude
+    // of that one, for entry index or for all entries. Throws
+    // std::invalid_argument if either is negative, or std::out_of_range if
+    // index is not below size().
+    void set_deadband(std::size_t index, double absolute, double relative = 0);
+    void set_deadband(double absolute, double relative = 0);
+
+    // Pass every entry on at least once per interval, or never if it is zero
+    void set_heartbeat(clock::duration interval);
+
+    // Compare the values, read at time now, and error codes to those last passed
+    // on, where the errors may be null, and return the number of changes. An
+    // entry with a nonzero error counts as a change only if the error does.
+    std::size_t update(double const* values, int const* errors, clock::time_point now);
+
+    // Compare the results of the last refresh() of a snapshot of size() entries,
+    // at their read times. Throws std::invalid_argument for another size.
+    std::size_t update(snapshot const& snap);
+
+    // Make every entry change on the next update()
+    void reset();
+
+    // Results of the last update(): bit i % 64 of word i / 64 is set if entry i
+    // changed. Bits past size() are clear.
+    std::uint64_t const* mask() const { return m_mask.get(); }
+    std::size_t mask_words() const { return (m_size + 63) / 64; }
+    bool changed(std::size_t index) const { return m_mask[index / 64] >> index % 64 & 1; }
+    std::size_t count() const { return m_count; }
+
+    // Call f(index) for every entry that changed, in order
+    template<typename F>
+    void for_each(F&& f) const
+    {
+        for (std::size_t w = 0; w < mask_words(); ++w)
+            for (auto bits = m_mask[w]; bits; bits &= bits - 1)
+                f(w * 64 + static_cast<std::size_t>(__builtin_ctzll(bits)));
+    }
+
+private:
+    // Entry i was read at times[i], or at now if times is null
+    std::size_t update(double const* values, int const* errors, clock::time_point const* times, clock::time_point now);
+    void update_band(std::size_t index);
+
+    std::size_t const m_size;
+    clock::duration m_heartbeat = clock::duration::max();
+    // Per entry, as last passed on
+    std::unique_ptr<double[]> const m_values;
+    std::unique_ptr<int[]> const m_errors;
+    std::unique_ptr<clock::time_point[]> const m_times;
+    std::unique_ptr<double[]> const m_absolute;
+    std::unique_ptr<double[]> const m_relative;
+    // The larger deadband around each value passed on
+    std::unique_ptr<double[]> const m_bands;
+    std::unique_ptr<std::uint64_t[]> const m_mask;
+    std::size_t m_count = 0;
+};
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_CHANGE_FILTER_H
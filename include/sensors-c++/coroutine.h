@@ -0,0 +1,193 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_COROUTINE_H
+#define LIBSENSORS_CPP_COROUTINE_H
+
+// Awaitable reads for C++20 coroutines. The library itself is built as C++17,
+// so this header is empty unless the including code enables coroutines.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "async.h"
+#include "error.h"
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <system_error>
+
+namespace sensors {
+
+// co_await async_read(reader, sub) suspends the awaiting coroutine until a
+// subfeature has been read, and resumes it on a thread of the reader with the
+// value. Throws a sensors::io_error if the read fails, like subfeature::read().
+class read_awaitable
+{
+public:
+    read_awaitable(async_reader& reader, sensors::subfeature sub)
+        : m_reader{reader}, m_subfeature{std::move(sub)}
+    {
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_op.handle = handle;
+        m_op.complete = &resume;
+        m_reader.read(m_subfeature, m_op);
+    }
+
+    double await_resume() const
+    {
+        if (m_op.error)
+            throw io_error{m_op.error};
+        return m_op.value;
+    }
+
+protected:
+    struct awaiting : async_reader::operation
+    {
+        std::coroutine_handle<> handle;
+    };
+
+    static void resume(async_reader::operation& op)
+    {
+        static_cast<awaiting&>(op).handle.resume();
+    }
+
+    async_reader& m_reader;
+    sensors::subfeature const m_subfeature;
+    awaiting m_op;
+};
+
+// co_await async_try_read(reader, sub, value) instead stores the value and
+// returns an error code, like subfeature::try_read()
+class try_read_awaitable : private read_awaitable
+{
+public:
+    try_read_awaitable(async_reader& reader, sensors::subfeature sub, double& value)
+        : read_awaitable{reader, std::move(sub)}, m_value{value}
+    {
+    }
+
+    using read_awaitable::await_ready;
+    using read_awaitable::await_suspend;
+
+    std::error_code await_resume() const noexcept
+    {
+        if (m_op.error)
+            return {-m_op.error, libsensors_category()};
+        m_value = m_op.value;
+        return {};
+    }
+
+private:
+    double& m_value;
+};
+
+// co_await async_read(reader, subs, count, values, errors) reads count
+// subfeatures at once and resumes the awaiting coroutine when all are done,
+// on a thread of the reader. Like a snapshot it stores a value and an error
+// code per subfeature, leaving the value unchanged if the read failed; errors
+// may be null. The reads are spread over the reader like separate ones, so one
+// slow subfeature holds up only this batch.
+class batch_read_awaitable
+{
+public:
+    batch_read_awaitable(async_reader& reader, sensors::subfeature const* subs, std::size_t count,
+            double* values, int* errors)
+        : m_reader{reader}, m_subfeatures{subs}, m_count{count}, m_values{values}, m_errors{errors}
+        , m_ops{count ? std::make_unique<awaiting[]>(count) : nullptr}
+    {
+    }
+
+    bool await_ready() const noexcept { return !m_count; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        // One more than the reads, so that the last completion cannot resume
+        // the coroutine, which would destroy this object, before all are started
+        m_remaining.store(m_count + 1, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < m_count; ++i) {
+            auto& op = m_ops[i];
+            op.batch = this;
+            op.index = i;
+            op.complete = &complete;
+            m_reader.read(m_subfeatures[i], op);
+        }
+        // Resume right away if every read completed meanwhile
+        return m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    struct awaiting : async_reader::operation
+    {
+        batch_read_awaitable* batch;
+        std::size_t index;
+    };
+
+    static void complete(async_reader::operation& op)
+    {
+        auto const& a = static_cast<awaiting&>(op);
+        auto const batch = a.batch;
+        if (!a.error)
+            batch->m_values[a.index] = a.value;
+        if (batch->m_errors)
+            batch->m_errors[a.index] = a.error;
+        if (batch->m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            batch->m_handle.resume();
+    }
+
+    async_reader& m_reader;
+    sensors::subfeature const* const m_subfeatures;
+    std::size_t const m_count;
+    double* const m_values;
+    int* const m_errors;
+    std::unique_ptr<awaiting[]> const m_ops;
+    std::atomic<std::size_t> m_remaining {0};
+    std::coroutine_handle<> m_handle;
+};
+
+inline read_awaitable async_read(async_reader& reader, sensors::subfeature const& sub)
+{
+    return {reader, sub};
+}
+
+inline try_read_awaitable async_try_read(async_reader& reader, sensors::subfeature const& sub, double& value)
+{
+    return {reader, sub, value};
+}
+
+inline batch_read_awaitable async_read(async_reader& reader, sensors::subfeature const* subs, std::size_t count,
+        double* values, int* errors = nullptr)
+{
+    return {reader, subs, count, values, errors};
+}
+
+} // sensors
+
+#endif // __cpp_impl_coroutine
+
+#endif // LIBSENSORS_CPP_COROUTINE_H
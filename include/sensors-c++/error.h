@@ -22,9 +22,30 @@
 #define LIBSENSORS_CPP_ERROR_H
 
 #include <stdexcept>
+#include <system_error>
 
 namespace sensors {
 
+// libsensors error codes, see <sensors/error.h>
+enum class errc {
+    wildcards = 1,
+    no_entry,
+    access_read,
+    kernel,
+    div_zero,
+    chip_name,
+    bus_name,
+    parse,
+    access_write,
+    io,
+    recursion
+};
+
+// Category of libsensors error codes. Messages are those of sensors_strerror.
+std::error_category const& libsensors_category() noexcept;
+
+std::error_code make_error_code(errc code) noexcept;
+
 // Base exception type, not used directly
 class error : public std::runtime_error
 {
@@ -50,4 +71,11 @@ class parse_error : public error
 
 } // sensors
 
+namespace std {
+
+template<>
+struct is_error_code_enum<sensors::errc> : true_type {};
+
+} // std
+
 #endif // LIBSENSORS_CPP_ERROR_H
@@ -0,0 +1,109 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_HISTORY_H
+#define LIBSENSORS_CPP_HISTORY_H
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+namespace sensors {
+
+// A fixed-capacity ring buffer of timestamped values, e.g. the samples of one
+// subfeature, which keeps the newest ones once it is full. Times and values are
+// stored in separate contiguous arrays that are allocated once on construction;
+// adding, querying and copying do not allocate. Times must not decrease, so
+// time ranges are found by binary search.
+//
+// A history is not synchronised. One that a snapshot fills belongs to the
+// snapshot's thread; those of a sampler are read through sampler::copy_history().
+class history
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // A contiguous part of the ring, oldest first
+    struct segment
+    {
+        clock::time_point const* times;
+        double const* values;
+        std::size_t size;
+    };
+
+    // Entries of a time range, which wraps around the end of the ring into a
+    // second segment if the first does not hold all of them. Valid until the
+    // history is changed.
+    struct window
+    {
+        segment first;
+        segment second;
+
+        std::size_t size() const { return first.size + second.size; }
+        bool empty() const { return !size(); }
+    };
+
+    explicit history(std::size_t capacity);
+    ~history();
+
+    history(history const&) = delete;
+    history& operator=(history const&) = delete;
+
+    std::size_t capacity() const { return m_capacity; }
+    std::size_t size() const { return m_size; }
+    bool empty() const { return !m_size; }
+
+    // Add an entry, replacing the oldest if the history is full. A time before
+    // that of the newest entry is raised to it.
+    void push(clock::time_point time, double value);
+    void clear();
+
+    // Entry i, counting from the oldest
+    clock::time_point time(std::size_t i) const;
+    double value(std::size_t i) const;
+
+    // All entries, and those with from <= time < to
+    window all() const;
+    window range(clock::time_point from, clock::time_point to) const;
+
+    // Copy the entries with from <= time < to to arrays that can hold them,
+    // either of which may be null, and return their number
+    std::size_t copy(clock::time_point from, clock::time_point to, clock::time_point* times, double* values) const;
+
+    // Replace the entries by those of other, or by its newest ones if it holds
+    // more than the capacity
+    void assign(history const& other);
+
+private:
+    std::size_t physical(std::size_t i) const;
+    std::size_t lower_bound(clock::time_point time) const;
+    window slice(std::size_t first, std::size_t last) const;
+
+    std::size_t const m_capacity;
+    std::unique_ptr<clock::time_point[]> const m_times;
+    std::unique_ptr<double[]> const m_values;
+    // Physical index of the oldest entry
+    std::size_t m_start = 0;
+    std::size_t m_size = 0;
+};
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_HISTORY_H
@@ -0,0 +1,181 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_SAMPLER_H
+#define LIBSENSORS_CPP_SAMPLER_H
+
+#include "sensors.h"
+#include "history.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sensors {
+
+class sysfs_attribute;
+
+// Samples subfeatures, each at its own period, and publishes the latest values.
+// Deadlines are absolute, so periods do not drift with the time spent reading.
+//
+// Reads are done on a background thread, or by the owner's event loop: fd()
+// can be added to an epoll set or the like, and drain() then takes the samples
+// that are due and returns those that are new.
+class sampler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Where the subfeatures are read
+    enum class threading {
+        // On a thread owned by the sampler
+        background,
+        // In drain(), by the thread that calls it
+        caller
+    };
+
+    struct sample
+    {
+        double value;
+        clock::time_point time;
+        // 0 on success or a negative libsensors error code, in which case value
+        // holds the last value read successfully
+        int error;
+    };
+
+    // A new sample of subfeature index, as returned by drain()
+    struct update
+    {
+        std::size_t index;
+        double value;
+        clock::time_point time;
+        int error;
+    };
+
+    struct statistics
+    {
+        // Number of times the thread woke up and read one or more subfeatures
+        std::uint64_t sweeps;
+        // Number of samples that were taken a full period or more late, and so
+        // skipped one or more periods
+        std::uint64_t deadline_misses;
+        clock::duration last_sweep;
+        clock::duration max_sweep;
+    };
+
+    // Throws a sensors::error if the timer could not be created
+    sampler();
+    ~sampler();
+
+    sampler(sampler const&) = delete;
+    sampler& operator=(sampler const&) = delete;
+
+    // Register a subfeature to be read every period and return its index for
+    // latest(), keeping a history of its last history_size successful samples
+    // if that is not 0. Throws std::logic_error if the sampler is running or if
+    // the period is not positive.
+    std::size_t add(sensors::subfeature const& sub, clock::duration period, std::size_t history_size = 0);
+
+    std::size_t size() const;
+
+    // Start or stop sampling. The first samples are taken right away with
+    // background threading, or by the first drain() with caller threading.
+    void start(threading mode = threading::background);
+    void stop();
+    bool running() const;
+
+    // A file descriptor that becomes readable when drain() has work to do:
+    // new samples of the background thread to return, or samples that are due
+    // with caller threading. It stays the same for the life of the sampler and
+    // must not be read or closed.
+    int fd() const;
+
+    // Replace the contents of out by the samples taken since the last call, at
+    // most one per subfeature, and return their number. With caller threading,
+    // first read the subfeatures that are due. Does not block, and does not
+    // allocate once out has grown to size(). Must not be called from more than
+    // one thread at a time.
+    std::size_t drain(std::vector<update>& out);
+
+    // The most recent sample of subfeature index, which has a default time
+    // point until it has been read. Safe to call from any thread.
+    sample latest(std::size_t index) const;
+
+    // Copy the history of subfeature index to out, keeping its newest samples
+    // if out is smaller, and return the number copied. Returns 0 if index has
+    // no history. Safe to call from any thread; the sampling thread waits for
+    // the copy to finish.
+    std::size_t copy_history(std::size_t index, history& out) const;
+
+    statistics stats() const;
+
+private:
+    struct entry
+    {
+        entry(sensors::subfeature const& sub, clock::duration period, std::size_t history_size);
+
+        sensors::subfeature subfeature;
+        sysfs_attribute const& attribute;
+        clock::duration period;
+        clock::time_point due;
+
+        // Published sample, guarded by a sequence lock: odd while being written
+        mutable std::atomic<unsigned> sequence {0};
+        std::atomic<double> value {0};
+        std::atomic<clock::rep> time {0};
+        std::atomic<int> error {0};
+
+        std::unique_ptr<sensors::history> const history;
+        mutable std::mutex history_lock;
+
+        // Sequence number of the last sample returned by drain()
+        unsigned drained = 0;
+    };
+
+    static sample load(entry const& e, unsigned& sequence);
+    void run();
+    void arm();
+    void sweep(clock::time_point now);
+
+    std::deque<entry> m_entries;
+    std::thread m_thread;
+    bool m_running = false;
+    int m_timer;
+    int m_wakeup;
+    // Signalled after every sweep of the background thread
+    int m_ready;
+    // Readable when the timer is, with caller threading, or m_ready is
+    int m_epoll;
+
+    std::atomic<std::uint64_t> m_sweeps {0};
+    std::atomic<std::uint64_t> m_misses {0};
+    std::atomic<clock::rep> m_last_sweep {0};
+    std::atomic<clock::rep> m_max_sweep {0};
+};
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_SAMPLER_H
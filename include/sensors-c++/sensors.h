@@ -21,15 +21,20 @@
 #ifndef LIBSENSORS_CPP_SENSORS_H
 #define LIBSENSORS_CPP_SENSORS_H
 
+#include <cstddef>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <vector>
 
 namespace sensors {
 
 class chip_name;
+class chip_pattern;
+class context;
 class feature;
 class subfeature;
 
@@ -100,13 +105,100 @@ enum class subfeature_type {
     unknown
 };
 
+// Sources of sensor data
+enum class backend {
+    // libsensors, which also applies its configuration file. This is the default.
+    libsensors,
+    // The hwmon device class in sysfs, read directly. It finds the same chips,
+    // features and subfeatures as libsensors, and applies the chip, label,
+    // compute and ignore statements of a configuration file if given one.
+    native
+};
+
+// Gives the library's utility classes access to internal data
+struct _sensors_access;
+
+// Handles point to records in a generation of the library's topology, which
+// their context keeps until it is destroyed, so that copying them is free
 template<typename T>
 struct _sensors_impl
 {
     struct impl;
-    std::shared_ptr<impl> m_impl;
-    _sensors_impl(impl&&);
-    operator impl const*() const;
+    impl const* m_impl;
+    _sensors_impl(impl const& record) : m_impl{&record} {}
+    operator impl const*() const { return m_impl; }
+
+    // Whether load_config() has replaced the generation this handle belongs to
+    bool stale() const;
+};
+
+// A lazy range of the chips of a context, the features of a chip or the
+// subfeatures of a feature. Objects are made as the range is iterated, without
+// allocating, so that a search can stop at the first match. Like the objects,
+// a range and its iterators are valid for as long as their context exists. Its
+// iterators are forward iterators in the C++20 sense, so ranges
+// compose with the views of <ranges>, e.g.
+//
+//     for (auto const& feat : chip.feature_range()
+//             | std::views::filter([](auto const& f) { return f.type() == feature_type::temp; })
+//             | std::views::take(1))
+//
+// A range converts to a std::vector of its objects.
+template<typename T>
+class object_range
+{
+    using record = typename _sensors_impl<T>::impl;
+
+public:
+    class iterator
+    {
+    public:
+        using iterator_concept = std::forward_iterator_tag;
+        // Dereferencing makes a new object, which is only an input iterator
+        // before C++20
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = T;
+        using pointer = void;
+
+        iterator() = default;
+
+        T operator*() const;
+        iterator& operator++() { ++m_index; return *this; }
+        iterator operator++(int) { auto const copy = *this; ++m_index; return copy; }
+        bool operator==(iterator const& other) const { return m_index == other.m_index; }
+        bool operator!=(iterator const& other) const { return m_index != other.m_index; }
+
+    private:
+        friend object_range;
+        iterator(record const* first, std::size_t index) : m_first{first}, m_index{index} {}
+
+        record const* m_first = nullptr;
+        std::size_t m_index = 0;
+    };
+
+    iterator begin() const { return {first(), 0}; }
+    iterator end() const { return {first(), m_size}; }
+    std::size_t size() const { return m_size; }
+    bool empty() const { return !m_size; }
+
+    // Object i, which must be less than size()
+    T operator[](std::size_t i) const { return *iterator{first(), i}; }
+    T front() const { return (*this)[0]; }
+
+    operator std::vector<T>() const;
+
+private:
+    friend context;
+    friend chip_name;
+    friend feature;
+
+    object_range(record const* first, std::size_t size) : m_first{first}, m_size{size} {}
+    record const* first() const { return m_first; }
+
+    record const* m_first;
+    std::size_t m_size;
 };
 
 // Holds the bus ID and number of a sensor chip
@@ -117,26 +209,121 @@ public:
     bus_id() = delete;
 
     // String representation of adapter type, e.g. "PCI adapter", or an empty
-    // string_view if it could not be found.
+    // string_view if it could not be found. Valid for as long as the context
+    // of this bus_id exists, see chip_name::name().
     std::string_view adapter_name() const;
     bus_type type() const;
     short nr() const;
 
+    using _sensors_impl::stale;
+
 private:
     using _sensors_impl::_sensors_impl;
 };
 
-// (Re)load a configuration file to use. This function attempts to call the
-// sensors_init() function and will throw a sensors::init_error if this file was
-// not found or there was an error in sensors_init. Calling this function is
-// optional and the argument may be empty; in both cases libsensors will be
-// loaded with the default configuration. Referencing any objects created before
-// calling this function is undefined behaviour.
-void load_config(std::string_view path);
+// Shared lock on the configuration of a context, by default that of
+// default_context(). Functions that use a context's configuration hold one
+// internally, and its load_config() waits until no read_lock on it exists in
+// any thread before it replaces the configuration. Objects stay valid without
+// one; hold one yourself only to keep a sequence of calls from seeing two
+// different configurations. Instances may be nested within a thread, which can
+// hold locks on up to 15 contexts at a time; locking one more throws a
+// std::logic_error.
+class read_lock
+{
+public:
+    read_lock();
+    explicit read_lock(context const& ctx);
+    ~read_lock();
+
+    read_lock(read_lock const&) = delete;
+    read_lock& operator=(read_lock const&) = delete;
+
+private:
+    context const& m_context;
+};
 
-// Return chip_name object for each sensor chip detected on the system, or fail
-// with a sensors::init_error if libsensors failed to initialise.
+// An independent view of the system's sensors: a backend with its own
+// configuration, chips, caches and lock, so that readers of different contexts
+// never wait for each other. Objects obtained from a context belong to it, and
+// must not be used after it is destroyed; it keeps the configurations that
+// load_config() replaced until then, for its stale objects.
+//
+// libsensors is a process-wide library, which only one context can use at a
+// time; any number of contexts can use the native backend.
+class context
+{
+public:
+    // Load a backend with a configuration file, see select_backend() and
+    // load_config(). Throws a sensors::init_error if that fails, or if
+    // libsensors is requested while another context uses it.
+    explicit context(backend type, std::string_view config_path = {}, std::string_view sysfs_root = "/sys");
+    ~context();
+
+    context(context const&) = delete;
+    context& operator=(context const&) = delete;
+
+    // (Re)load a configuration file to use. The libsensors backend passes it
+    // to sensors_init() and uses the default configuration if the path is
+    // empty; the native backend parses it itself and uses no configuration if
+    // the path is empty. Throws a sensors::init_error if the file was not found
+    // or could not be parsed.
+    //
+    // Objects created before the call remain valid and become stale(): their
+    // properties, including names and labels, are those of the configuration
+    // they were obtained from. Those of the native backend keep reading from
+    // sysfs with their configuration, while reads and writes of libsensors
+    // objects are looked up in the current libsensors configuration and fail
+    // with errc::no_entry if their chip no longer exists. Reading a subfeature
+    // directly from sysfs never waits for this function.
+    //
+    // This function waits for all read_locks on this context to be released and
+    // throws a std::logic_error if the calling thread holds one. The new
+    // configuration is loaded alongside the current one, which stays in use if
+    // it fails; libsensors then loads the current one again.
+    void load_config(std::string_view path);
+
+    // Switch to the given backend with its default configuration. The native
+    // backend looks for chips in the class/hwmon directory of sysfs_root, which
+    // libsensors always finds by itself. Otherwise this function behaves the
+    // same as load_config().
+    void select_backend(backend type, std::string_view sysfs_root = "/sys");
+
+    // Return a chip_name object for each sensor chip detected by the backend.
+    std::vector<chip_name> get_detected_chips() const;
+
+    // Return only the chips that match a pattern and are on a bus of the given
+    // type, e.g. get_detected_chips(chip_pattern{"coretemp-*"}) or
+    // get_detected_chips({}, bus_type::pci). Only matching chips are made into
+    // objects; to filter lazily instead, use a chip_pattern with the views of
+    // <ranges> on detected_chips().
+    std::vector<chip_name> get_detected_chips(chip_pattern const& pattern, bus_type bus = bus_type::any) const;
+
+    // The same chips as get_detected_chips(), as a range that makes them as
+    // it is iterated, without allocating
+    object_range<chip_name> detected_chips() const;
+
+private:
+    friend read_lock;
+    friend _sensors_access;
+
+    struct state;
+    std::unique_ptr<state> m_state;
+};
+
+// The context used by the free functions below and by the constructors that do
+// not take one. It is created with the libsensors backend and its default
+// configuration on first use, which throws a sensors::init_error if libsensors
+// fails to initialise. If the environment variable SENSORS_CPP_SYSFS_ROOT is
+// set, it uses the native backend with that sysfs root instead.
+context& default_context();
+
+// The same as the member functions of default_context()
+void load_config(std::string_view path);
+void select_backend(backend type, std::string_view sysfs_root = "/sys");
 std::vector<chip_name> get_detected_chips();
+std::vector<chip_name> get_detected_chips(chip_pattern const& pattern, bus_type bus = bus_type::any);
+object_range<chip_name> detected_chips();
 
 class chip_name : private _sensors_impl<chip_name>
 {
@@ -149,29 +336,70 @@ public:
     chip_name() = delete;
 
     // Construct a chip_name from its path in the hwmon device class, e.g.
-    // /sys/class/hwmon/hwmon0. This constructor throws a sensors::init_error if
-    // there was an error loading the libsensors resources, or a
-    // sensors::parse_error if no chip was found matching the given path.
+    // /sys/class/hwmon/hwmon0, or a path inside that directory. This constructor
+    // throws a sensors::init_error if the default context could not be loaded,
+    // or a sensors::parse_error if no chip was found at the given path.
     explicit chip_name(std::string_view path);
+    chip_name(context const& ctx, std::string_view path);
 
-    // Chip data
+    // Chip data. The string_views are valid for as long as the context of
+    // this chip_name exists, see name().
     int address() const;
     bus_id bus() const;
     std::string_view prefix() const;
     std::string_view path() const;
 
-    // Chip name as obtained from sensors_snprintf_chip_name. Will throw a
-    // sensors::io_error if that function reports an error.
-    std::string name() const;
+    // Chip name as obtained from sensors_snprintf_chip_name when the
+    // configuration was loaded. Will throw a sensors::io_error if that function
+    // reported an error.
+    //
+    // Like other string_views returned by these classes, the result points
+    // into the generation the object belongs to, which its context keeps
+    // until it is destroyed, even after load_config() replaced it. Copy it
+    // into a std::string to keep it longer.
+    std::string_view name() const;
 
+    // Return all features of this chip, or a range of them that does not
+    // allocate
     std::vector<feature> features() const;
+    object_range<feature> feature_range() const;
+
+    using _sensors_impl::stale;
 
 private:
     using _sensors_impl::_sensors_impl;
+    friend chip_pattern;
+    friend object_range<chip_name>;
     friend _sensors_impl<feature>;
     friend _sensors_impl<subfeature>;
 };
 
+// A chip name pattern as used by configuration files and the sensors program,
+// e.g. "coretemp-*", "nct6775-isa-*" or "*-i2c-0-2d", parsed once by
+// sensors_parse_chip_name(). A default-constructed pattern matches any chip.
+class chip_pattern
+{
+public:
+    chip_pattern() = default;
+
+    // Throws a sensors::parse_error if the pattern is invalid
+    explicit chip_pattern(std::string_view pattern);
+
+    // See sensors_match_chip()
+    bool matches(chip_name const& chip) const;
+    bool operator()(chip_name const& chip) const { return matches(chip); }
+
+private:
+    friend context;
+    bool matches(_sensors_impl<chip_name>::impl const& chip) const;
+
+    // Fields of the parsed sensors_chip_name
+    std::optional<std::string> m_prefix;
+    short m_bus_type = -1;
+    short m_bus_nr = -1;
+    int m_address = -1;
+};
+
 class feature : private _sensors_impl<feature>
 {
 public:
@@ -183,32 +411,42 @@ public:
     // name of a subfeature, e.g. /sys/class/hwmon/hwmon0/temp1[_input]. Throws
     // a sensors::parse_error if no such feature was found.
     explicit feature(std::string_view full_path);
+    feature(context const& ctx, std::string_view full_path);
 
     // Construct a feature from the filesystem path of its chip and its name,
     // e.g. /sys/class/hwmon/hwmon0, temp1. Throws a sensors::parse_error if no
     // such feature was found.
     feature(std::string_view chip_path, std::string_view feature_name);
+    feature(context const& ctx, std::string_view chip_path, std::string_view feature_name);
 
-    // Parent chip
-    chip_name const& chip() const;
+    // Parent chip, a new handle to it of the same generation
+    chip_name chip() const;
 
-    // Feature data
+    // Feature data. name() is valid for as long as the context of this
+    // feature exists, see chip_name::name().
     std::string_view name() const;
     int number() const;
     feature_type type() const;
 
-    // Feature label as reported by sensors_get_label; if no label exists, the
-    // output is the same as name().
-    std::string label() const;
+    // Feature label as reported by sensors_get_label when the configuration was
+    // loaded, which is that of a label statement in the configuration, that of
+    // the chip or else the same as name(). Valid for as long as the context
+    // of this feature exists, see chip_name::name().
+    std::string_view label() const;
 
-    // Return all subfeatures of this feature
+    // Return all subfeatures of this feature, or a range of them that does not
+    // allocate
     std::vector<sensors::subfeature> subfeatures() const;
+    object_range<sensors::subfeature> subfeature_range() const;
 
     // Return the subfeature of the given type, if it exists
     std::optional<sensors::subfeature> subfeature(subfeature_type type) const;
 
+    using _sensors_impl::stale;
+
 private:
     using _sensors_impl::_sensors_impl;
+    friend object_range<feature>;
     friend _sensors_impl<class subfeature>;
 };
 
@@ -216,6 +454,8 @@ private:
 class subfeature : private _sensors_impl<subfeature>
 {
 public:
+    friend _sensors_access;
+
     // A subfeature can only be constructed from a string parameter or obtained
     // from its parent feature
     subfeature() = delete;
@@ -224,11 +464,13 @@ public:
     // /sys/class/hwmon/hwmon0/temp1_input. Throws a sensors::parse_error if no
     // such subfeature was found.
     explicit subfeature(std::string_view path);
+    subfeature(context const& ctx, std::string_view path);
 
-    // Parent feature
-    sensors::feature const& feature() const;
+    // Parent feature, a new handle to it of the same generation
+    sensors::feature feature() const;
 
-    // Subfeature data
+    // Subfeature data. name() is valid for as long as the context of this
+    // subfeature exists, see chip_name::name().
     std::string_view name() const;
     int number() const;
     subfeature_type type() const;
@@ -244,14 +486,25 @@ public:
     // computation rules of its parent feature)
     bool compute_mapping() const;
 
-    // Return the value read, or throw a sensors::io_error
+    // Return the value read, or throw a sensors::io_error. The attribute file is
+    // kept open after the first call and reread in place; values are the same as
+    // those returned by sensors_get_value.
     double read() const;
 
     // Write the given value, or throw a sensors::io_error
     void write(double value) const;
 
+    // Non-throwing versions of read() and write(). Errors are returned as codes
+    // in sensors::libsensors_category(), which can be compared to sensors::errc
+    // values; on failure, value is left unchanged.
+    std::error_code try_read(double& value) const noexcept;
+    std::error_code try_write(double value) const noexcept;
+
+    using _sensors_impl::stale;
+
 private:
     using _sensors_impl::_sensors_impl;
+    friend object_range<subfeature>;
 };
 
 } // sensors
@@ -0,0 +1,112 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_SNAPSHOT_H
+#define LIBSENSORS_CPP_SNAPSHOT_H
+
+#include "sensors.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace sensors {
+
+class history;
+class sysfs_attribute;
+class uring;
+
+// How a snapshot performs its reads
+enum class read_engine {
+    // One blocking read after another
+    sync,
+    // All reads submitted to an io_uring instance at once. Falls back to sync
+    // if io_uring is not available.
+    io_uring,
+    // The subfeatures of each bus, by type and number, read one after another
+    // by a thread of their own, so that a refresh takes as long as the slowest
+    // bus rather than all of them together. The refreshing thread reads one of
+    // the buses itself. Falls back to sync if there is only one bus.
+    per_bus
+};
+
+// A fixed set of subfeatures that are read together. The values, read times and
+// error codes of the last refresh() are stored in contiguous arrays that are
+// allocated once on construction; refreshing does not allocate.
+class snapshot
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Snapshot of every readable subfeature of every detected chip. Throws a
+    // sensors::init_error if libsensors failed to initialise.
+    explicit snapshot(read_engine engine = read_engine::sync);
+
+    // Snapshot of the given subfeatures, in the given order
+    explicit snapshot(std::vector<sensors::subfeature> subfeatures, read_engine engine = read_engine::sync);
+
+    snapshot(snapshot&&) noexcept;
+    snapshot& operator=(snapshot&&) noexcept;
+    ~snapshot();
+
+    // The engine in use, which is read_engine::sync if another was requested
+    // but is not available
+    read_engine engine() const;
+
+    // Read all subfeatures. Failures do not throw but are recorded in errors().
+    void refresh();
+
+    std::size_t size() const;
+
+    // The subfeatures read, in the order of the value arrays
+    std::vector<sensors::subfeature> const& subfeatures() const;
+
+    // Results of the last refresh(); entry i belongs to subfeatures()[i]. An
+    // error is 0 on success or a negative libsensors error code, in which case
+    // the value is left unchanged.
+    std::vector<double> const& values() const;
+    std::vector<clock::time_point> const& times() const;
+    std::vector<int> const& errors() const;
+
+    // Add every value of subfeature index that refresh() reads successfully to
+    // a history, which must outlive the snapshot, or stop if it is nullptr
+    void attach(std::size_t index, history* h);
+
+private:
+    std::vector<sensors::subfeature> m_subfeatures;
+    std::vector<sysfs_attribute const*> m_attributes;
+    std::vector<double> m_values;
+    std::vector<clock::time_point> m_times;
+    std::vector<int> m_errors;
+    // Empty until the first attach()
+    std::vector<history*> m_histories;
+    std::unique_ptr<uring> m_ring;
+    std::vector<char> m_buffers;
+    struct bus_workers;
+    std::unique_ptr<bus_workers> m_workers;
+
+    void refresh_sync(std::size_t first, std::size_t last);
+    void refresh_ring();
+};
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_SNAPSHOT_H
@@ -0,0 +1,224 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sensors-c++/aggregate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SENSORS_CPP_X86 1
+#include <immintrin.h>
+#endif
+
+namespace sensors {
+
+namespace {
+
+// Running sums of values relative to a shift, which the kernels extend
+struct sums
+{
+    std::size_t count = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0;
+    double squares = 0;
+};
+
+using kernel = void (*)(double const* values, std::size_t count, double shift, sums& s);
+
+void accumulate_scalar(double const* values, std::size_t count, double shift, sums& s)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        auto const d = values[i] - shift;
+        s.min = std::min(s.min, values[i]);
+        s.max = std::max(s.max, values[i]);
+        s.sum += d;
+        s.squares += d * d;
+    }
+    s.count += count;
+}
+
+#ifdef SENSORS_CPP_X86
+
+// Two vectors per iteration, so that the additions of one do not wait for the
+// other's
+__attribute__((target("sse2")))
+void accumulate_sse2(double const* values, std::size_t count, double shift, sums& s)
+{
+    auto const k = _mm_set1_pd(shift);
+    auto min0 = _mm_set1_pd(s.min), min1 = min0;
+    auto max0 = _mm_set1_pd(s.max), max1 = max0;
+    auto sum0 = _mm_setzero_pd(), sum1 = sum0, squares0 = sum0, squares1 = sum0;
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto const a = _mm_loadu_pd(values + i);
+        auto const b = _mm_loadu_pd(values + i + 2);
+        min0 = _mm_min_pd(min0, a);
+        min1 = _mm_min_pd(min1, b);
+        max0 = _mm_max_pd(max0, a);
+        max1 = _mm_max_pd(max1, b);
+        auto const da = _mm_sub_pd(a, k);
+        auto const db = _mm_sub_pd(b, k);
+        sum0 = _mm_add_pd(sum0, da);
+        sum1 = _mm_add_pd(sum1, db);
+        squares0 = _mm_add_pd(squares0, _mm_mul_pd(da, da));
+        squares1 = _mm_add_pd(squares1, _mm_mul_pd(db, db));
+    }
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, _mm_min_pd(min0, min1));
+    s.min = std::min({s.min, lanes[0], lanes[1]});
+    _mm_store_pd(lanes, _mm_max_pd(max0, max1));
+    s.max = std::max({s.max, lanes[0], lanes[1]});
+    _mm_store_pd(lanes, _mm_add_pd(sum0, sum1));
+    s.sum += lanes[0] + lanes[1];
+    _mm_store_pd(lanes, _mm_add_pd(squares0, squares1));
+    s.squares += lanes[0] + lanes[1];
+    s.count += i;
+    accumulate_scalar(values + i, count - i, shift, s);
+}
+
+template<typename Op>
+__attribute__((target("avx")))
+double reduce(__m256d v, Op const& op)
+{
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, v);
+    return op(op(lanes[0], lanes[1]), op(lanes[2], lanes[3]));
+}
+
+__attribute__((target("avx2,fma")))
+void accumulate_avx2(double const* values, std::size_t count, double shift, sums& s)
+{
+    auto const k = _mm256_set1_pd(shift);
+    auto min0 = _mm256_set1_pd(s.min), min1 = min0;
+    auto max0 = _mm256_set1_pd(s.max), max1 = max0;
+    auto sum0 = _mm256_setzero_pd(), sum1 = sum0, squares0 = sum0, squares1 = sum0;
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto const a = _mm256_loadu_pd(values + i);
+        auto const b = _mm256_loadu_pd(values + i + 4);
+        min0 = _mm256_min_pd(min0, a);
+        min1 = _mm256_min_pd(min1, b);
+        max0 = _mm256_max_pd(max0, a);
+        max1 = _mm256_max_pd(max1, b);
+        auto const da = _mm256_sub_pd(a, k);
+        auto const db = _mm256_sub_pd(b, k);
+        sum0 = _mm256_add_pd(sum0, da);
+        sum1 = _mm256_add_pd(sum1, db);
+        squares0 = _mm256_fmadd_pd(da, da, squares0);
+        squares1 = _mm256_fmadd_pd(db, db, squares1);
+    }
+    s.min = std::min(s.min, reduce(_mm256_min_pd(min0, min1), [](double a, double b) { return std::min(a, b); }));
+    s.max = std::max(s.max, reduce(_mm256_max_pd(max0, max1), [](double a, double b) { return std::max(a, b); }));
+    s.sum += reduce(_mm256_add_pd(sum0, sum1), std::plus<>{});
+    s.squares += reduce(_mm256_add_pd(squares0, squares1), std::plus<>{});
+    s.count += i;
+    // The SSE2 kernel has legacy encodings, which are slow while the upper
+    // halves of the registers are in use
+    _mm256_zeroupper();
+    accumulate_sse2(values + i, count - i, shift, s);
+}
+
+#endif
+
+instruction_set detect()
+{
+#ifdef SENSORS_CPP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return instruction_set::avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return instruction_set::sse2;
+#endif
+    return instruction_set::scalar;
+}
+
+kernel select(instruction_set isa)
+{
+    switch (std::min(isa, native_instruction_set())) {
+#ifdef SENSORS_CPP_X86
+    case instruction_set::avx2: return accumulate_avx2;
+    case instruction_set::sse2: return accumulate_sse2;
+#endif
+    default: return accumulate_scalar;
+    }
+}
+
+kernel native_kernel()
+{
+    static kernel const k = select(native_instruction_set());
+    return k;
+}
+
+window_statistics finish(sums const& s, double shift)
+{
+    if (!s.count) {
+        auto const nan = std::numeric_limits<double>::quiet_NaN();
+        return {0, nan, nan, nan, nan};
+    }
+    auto const n = static_cast<double>(s.count);
+    auto const mean = s.sum / n;
+    auto const variance = std::max(0.0, s.squares / n - mean * mean);
+    return {s.count, s.min, s.max, shift + mean, std::sqrt(variance)};
+}
+
+} // anonymous namespace
+
+instruction_set native_instruction_set()
+{
+    static instruction_set const isa = detect();
+    return isa;
+}
+
+window_statistics aggregate(double const* values, std::size_t count)
+{
+    sums s;
+    auto const shift = count ? values[0] : 0;
+    native_kernel()(values, count, shift, s);
+    return finish(s, shift);
+}
+
+window_statistics aggregate(double const* values, std::size_t count, instruction_set isa)
+{
+    sums s;
+    auto const shift = count ? values[0] : 0;
+    select(isa)(values, count, shift, s);
+    return finish(s, shift);
+}
+
+window_statistics aggregate(history::window const& w)
+{
+    sums s;
+    auto const shift = w.first.size ? w.first.values[0] : 0;
+    auto const k = native_kernel();
+    k(w.first.values, w.first.size, shift, s);
+    k(w.second.values, w.second.size, shift, s);
+    return finish(s, shift);
+}
+
+window_statistics aggregate(history const& h, history::clock::time_point from, history::clock::time_point to)
+{
+    return aggregate(h.range(from, to));
+}
+
+} // sensors
@@ -0,0 +1,261 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sensors-c++/alarm_watcher.h"
+#include "sensors-c++/error.h"
+#include "impl.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace sensors {
+
+namespace {
+
+// Event data of the timer and wakeup descriptors; those of subfeatures are
+// their indices
+constexpr std::uint64_t timer_event = UINT64_MAX;
+constexpr std::uint64_t wakeup_event = UINT64_MAX - 1;
+
+init_error system_error(char const* what)
+{
+    return init_error{std::string{what} + " (" + std::strerror(errno) + ")"};
+}
+
+timespec to_timespec(alarm_watcher::clock::duration duration)
+{
+    auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(duration);
+    auto const nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration - seconds);
+    return {static_cast<time_t>(seconds.count()), static_cast<long>(nanoseconds.count())};
+}
+
+} // anonymous namespace
+
+bool is_alarm(subfeature_type type)
+{
+    switch (type) {
+    case subfeature_type::alarm:
+    case subfeature_type::cap_alarm:
+    case subfeature_type::min_alarm:
+    case subfeature_type::max_alarm:
+    case subfeature_type::crit_alarm:
+    case subfeature_type::l_crit_alarm:
+    case subfeature_type::emergency_alarm:
+    case subfeature_type::fault:
+        return true;
+    default:
+        return false;
+    }
+}
+
+alarm_watcher::entry::entry(sensors::subfeature const& sub, callback on_change)
+    : subfeature{sub}
+    , attribute{_sensors_access::attribute(sub)}
+    , on_change{std::move(on_change)}
+{
+    // A read through any descriptor of the same open file rearms its
+    // notification, so files read directly get one that only the watcher uses
+    if (attribute.fd() >= 0) {
+        auto const path = std::string{sub.feature().chip().path()} + '/' + std::string{sub.name()};
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+}
+
+alarm_watcher::entry::~entry()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+alarm_watcher::alarm_watcher(clock::duration period)
+    : m_period{period}
+    , m_epoll{::epoll_create1(EPOLL_CLOEXEC)}
+    , m_timer{::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)}
+    , m_wakeup{::eventfd(0, EFD_CLOEXEC)}
+{
+    auto const close_all = [this]{
+        for (auto fd : {m_epoll, m_timer, m_wakeup})
+            if (fd >= 0)
+                ::close(fd);
+    };
+    if (period <= clock::duration::zero()) {
+        close_all();
+        throw std::logic_error{"Polling period must be positive"};
+    }
+    epoll_event timer {EPOLLIN, {}}, wakeup {EPOLLIN, {}};
+    timer.data.u64 = timer_event;
+    wakeup.data.u64 = wakeup_event;
+    if (m_epoll < 0 || m_timer < 0 || m_wakeup < 0
+            || ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_timer, &timer)
+            || ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &wakeup)) {
+        auto const error = system_error("Failed to create alarm watcher");
+        close_all();
+        throw error;
+    }
+}
+
+alarm_watcher::~alarm_watcher()
+{
+    stop();
+    ::close(m_epoll);
+    ::close(m_timer);
+    ::close(m_wakeup);
+}
+
+std::size_t alarm_watcher::add(sensors::subfeature const& sub, callback on_change)
+{
+    if (running())
+        throw std::logic_error{"Cannot add subfeatures to a running alarm watcher"};
+    if (!sub.readable())
+        throw std::logic_error{"Cannot watch a subfeature that is not readable"};
+    auto& e = m_entries.emplace_back(sub, std::move(on_change));
+    auto const index = m_entries.size() - 1;
+
+    // sysfs files accept EPOLLPRI and signal it once sysfs_notify() is called,
+    // until they are read again. epoll refuses regular files, which never do.
+    if (e.fd >= 0) {
+        epoll_event notify {EPOLLPRI, {}};
+        notify.data.u64 = index;
+        e.notifies = !::epoll_ctl(m_epoll, EPOLL_CTL_ADD, e.fd, &notify);
+    }
+    return index;
+}
+
+std::size_t alarm_watcher::add_alarms(context const& ctx, callback const& on_change)
+{
+    read_lock const lock {ctx};
+    std::size_t count = 0;
+    for (auto const& chip : ctx.detected_chips())
+        for (auto const& feat : chip.feature_range())
+            for (auto const& sub : feat.subfeature_range())
+                if (is_alarm(sub.type()) && sub.readable()) {
+                    add(sub, on_change);
+                    ++count;
+                }
+    return count;
+}
+
+std::size_t alarm_watcher::size() const
+{
+    return m_entries.size();
+}
+
+subfeature const& alarm_watcher::subfeature(std::size_t index) const
+{
+    return m_entries[index].subfeature;
+}
+
+bool alarm_watcher::notifies(std::size_t index) const
+{
+    return m_entries[index].notifies;
+}
+
+void alarm_watcher::start()
+{
+    if (running())
+        return;
+    for (auto& e : m_entries) {
+        double value;
+        e.error = read(e, value);
+        if (!e.error)
+            e.value.store(value, std::memory_order_relaxed);
+    }
+    itimerspec const period {to_timespec(m_period), to_timespec(m_period)};
+    ::timerfd_settime(m_timer, 0, &period, nullptr);
+    m_thread = std::thread{&alarm_watcher::run, this};
+}
+
+void alarm_watcher::stop()
+{
+    if (!running())
+        return;
+    std::uint64_t value = 1;
+    ::write(m_wakeup, &value, sizeof value);
+    m_thread.join();
+    ::read(m_wakeup, &value, sizeof value);
+    itimerspec const disarm {};
+    ::timerfd_settime(m_timer, 0, &disarm, nullptr);
+}
+
+bool alarm_watcher::running() const
+{
+    return m_thread.joinable();
+}
+
+double alarm_watcher::value(std::size_t index) const
+{
+    return m_entries[index].value.load(std::memory_order_relaxed);
+}
+
+void alarm_watcher::run()
+{
+    epoll_event events[64];
+    while (true) {
+        auto const count = ::epoll_wait(m_epoll, events, 64, -1);
+        for (int i = 0; i < count; ++i) {
+            auto const data = events[i].data.u64;
+            if (data == wakeup_event)
+                return;
+            if (data == timer_event) {
+                std::uint64_t expirations;
+                ::read(m_timer, &expirations, sizeof expirations);
+                for (std::size_t j = 0; j < m_entries.size(); ++j)
+                    check(j);
+            } else {
+                // Reading the file also rearms the notification
+                check(data);
+            }
+        }
+    }
+}
+
+void alarm_watcher::check(std::size_t index)
+{
+    auto& e = m_entries[index];
+    double value = e.value.load(std::memory_order_relaxed);
+    auto const error = read(e, value);
+    if (error == e.error && (error || value == e.value.load(std::memory_order_relaxed)))
+        return;
+    e.error = error;
+    if (!error)
+        e.value.store(value, std::memory_order_relaxed);
+    if (e.on_change)
+        e.on_change({index, value, error, clock::now()});
+}
+
+int alarm_watcher::read(entry const& e, double& value)
+{
+    if (e.fd < 0)
+        return e.attribute.read(value);
+    char buffer[sysfs_attribute::buffer_size];
+    auto const size = ::pread(e.fd, buffer, sizeof buffer - 1, 0);
+    return e.attribute.parse(buffer, size < 0 ? -errno : size, value);
+}
+
+} // sensors
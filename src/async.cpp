@@ -0,0 +1,273 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sensors-c++/async.h"
+#include "impl.h"
+#include "uring.h"
+
+#include <condition_variable>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace sensors {
+
+namespace {
+
+// Size of the submission queue, and the number of reads the ring has in
+// progress at most
+constexpr unsigned ring_entries = 256;
+
+} // anonymous namespace
+
+struct async_reader::state
+{
+    // A first in, first out list of operations, linked through their next
+    struct queue
+    {
+        operation* head = nullptr;
+        operation* tail = nullptr;
+
+        bool empty() const { return !head; }
+
+        void push(operation& op)
+        {
+            op.next = nullptr;
+            (tail ? tail->next : head) = &op;
+            tail = &op;
+        }
+
+        operation& pop()
+        {
+            auto& op = *head;
+            head = op.next;
+            if (!head)
+                tail = nullptr;
+            return op;
+        }
+    };
+
+    ~state()
+    {
+        if (ring_event >= 0)
+            ::close(ring_event);
+    }
+
+    // Reads started and not yet complete, including those started by
+    // completions, which the destructor waits for
+    std::mutex idle_lock;
+    std::condition_variable idle;
+    unsigned outstanding = 0;
+
+    // Reads done by the I/O thread
+    std::mutex io_lock;
+    std::condition_variable io_ready;
+    queue io_queue;
+    bool stopping = false;
+    std::thread io_thread;
+
+    // Reads through the ring, those of which that wait for room in it and the
+    // thread that handles their completions, which waits on ring_event. Once
+    // submitting to the ring fails, reads go to the I/O thread instead.
+    std::unique_ptr<uring> ring;
+    int ring_event = -1;
+    std::mutex ring_lock;
+    unsigned in_flight = 0;
+    queue waiting;
+    bool ring_failed = false;
+    bool ring_stopping = false;
+    std::thread completion_thread;
+
+    void run_io();
+    void run_completions();
+    void start(operation& op);
+    void fall_back(operation& op);
+    void finish(operation& op);
+};
+
+// Call the completion of a read, after which the operation may be gone
+void async_reader::state::finish(operation& op)
+{
+    op.complete(op);
+    // Notify under the lock, so that the destructor cannot see the count drop
+    // to zero and destroy the state before this thread is done with it
+    std::lock_guard const lock {idle_lock};
+    if (!--outstanding)
+        idle.notify_all();
+}
+
+void async_reader::state::run_io()
+{
+    std::unique_lock lock {io_lock};
+    while (true) {
+        io_ready.wait(lock, [this]{ return !io_queue.empty() || stopping; });
+        if (io_queue.empty())
+            return;
+        auto& op = io_queue.pop();
+        lock.unlock();
+        op.error = op.attribute->read(op.value);
+        finish(op);
+        lock.lock();
+    }
+}
+
+// Hand a read to the I/O thread; ring_lock may be held
+void async_reader::state::fall_back(operation& op)
+{
+    {
+        std::lock_guard const lock {io_lock};
+        io_queue.push(op);
+    }
+    io_ready.notify_one();
+}
+
+// Queue a read on the ring and submit it, or give up on the ring if that fails,
+// like snapshot::refresh_ring does; ring_lock must be held
+void async_reader::state::start(operation& op)
+{
+    if (!ring_failed) {
+        ring->prepare_read(op.attribute->fd(), op.buffer, sizeof op.buffer - 1, reinterpret_cast<std::uintptr_t>(&op));
+        auto const error = ring->submit();
+        if (!error) {
+            ++in_flight;
+            return;
+        }
+        // The read never reached the kernel, so it is not carried out twice
+        ring->discard();
+        // The kernel is short of resources for now: leave only this read to the
+        // I/O thread, rather than retry while holding ring_lock
+        if (error == -EAGAIN)
+            return fall_back(op);
+        ring_failed = true;
+        while (!waiting.empty())
+            fall_back(waiting.pop());
+    }
+    fall_back(op);
+}
+
+void async_reader::state::run_completions()
+{
+    while (true) {
+        // The eventfd counts completions, but may also be signalled to stop the
+        // thread. Should reading it fail, poll the ring rather than spin.
+        std::uint64_t count;
+        if (::read(ring_event, &count, sizeof count) < 0 && errno != EINTR)
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+        unsigned completed = 0;
+        // The operation may be gone once it is complete, so finish with it first
+        ring->reap([&](std::uint64_t data, int result) {
+            auto& op = *reinterpret_cast<operation*>(data);
+            op.error = op.attribute->parse(op.buffer, result, op.value);
+            ++completed;
+            finish(op);
+        });
+
+        std::lock_guard const lock {ring_lock};
+        in_flight -= completed;
+        while (in_flight < ring_entries && !waiting.empty())
+            start(waiting.pop());
+        if (ring_stopping && !in_flight)
+            return;
+    }
+}
+
+async_reader::async_reader(read_engine engine)
+    : m_state{std::make_unique<state>()}
+{
+    if (engine == read_engine::io_uring) {
+        auto& s = *m_state;
+        s.ring = std::make_unique<uring>(ring_entries);
+        s.ring_event = ::eventfd(0, EFD_CLOEXEC);
+        if (s.ring->valid() && s.ring_event >= 0 && !s.ring->register_eventfd(s.ring_event)) {
+            s.completion_thread = std::thread{&state::run_completions, &s};
+        } else {
+            s.ring.reset();
+            if (s.ring_event >= 0)
+                ::close(s.ring_event);
+            s.ring_event = -1;
+        }
+    }
+    m_state->io_thread = std::thread{&state::run_io, m_state.get()};
+}
+
+async_reader::~async_reader()
+{
+    // Completions on either thread may start reads on the other, so both are
+    // kept running until no read is left
+    {
+        std::unique_lock lock {m_state->idle_lock};
+        m_state->idle.wait(lock, [this]{ return !m_state->outstanding; });
+    }
+    if (m_state->ring) {
+        {
+            std::lock_guard const lock {m_state->ring_lock};
+            m_state->ring_stopping = true;
+        }
+        std::uint64_t const one = 1;
+        while (::write(m_state->ring_event, &one, sizeof one) < 0 && errno == EINTR)
+            ;
+        m_state->completion_thread.join();
+    }
+    {
+        std::lock_guard const lock {m_state->io_lock};
+        m_state->stopping = true;
+    }
+    m_state->io_ready.notify_one();
+    m_state->io_thread.join();
+}
+
+read_engine async_reader::engine() const
+{
+    if (!m_state->ring)
+        return read_engine::sync;
+    std::lock_guard const lock {m_state->ring_lock};
+    return m_state->ring_failed ? read_engine::sync : read_engine::io_uring;
+}
+
+void async_reader::read(sensors::subfeature const& sub, operation& op)
+{
+    static_assert(sizeof op.buffer == sysfs_attribute::buffer_size);
+    op.attribute = &_sensors_access::attribute(sub);
+
+    auto& s = *m_state;
+    {
+        std::lock_guard const lock {s.idle_lock};
+        ++s.outstanding;
+    }
+
+    // Reads that are delegated to libsensors have no file to give the ring
+    if (s.ring && op.attribute->fd() >= 0) {
+        std::lock_guard const lock {s.ring_lock};
+        if (s.in_flight < ring_entries || s.ring_failed)
+            s.start(op);
+        else
+            s.waiting.push(op);
+        return;
+    }
+    s.fall_back(op);
+}
+
+} // sensors
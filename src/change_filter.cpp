@@ -0,0 +1,186 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sensors-c++/change_filter.h"
+#include "sensors-c++/snapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SENSORS_CPP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace sensors {
+
+namespace {
+
+// Error code of entries that have not been passed on yet; libsensors error
+// codes are 0 or negative
+constexpr int never = 1;
+
+// Bit j is set if value j differs from last by more than band, for n <= 64
+// values
+std::uint64_t value_changes(double const* values, double const* last, double const* band, std::size_t n)
+{
+    std::uint64_t bits = 0;
+    std::size_t j = 0;
+#ifdef SENSORS_CPP_SSE2
+    // Eight at a time, to need only one variable shift for their bits
+    auto const sign = _mm_set1_pd(-0.0);
+    auto const pair = [&](std::size_t k) {
+        auto const difference = _mm_andnot_pd(sign, _mm_sub_pd(_mm_loadu_pd(values + k), _mm_loadu_pd(last + k)));
+        return _mm_movemask_pd(_mm_cmpgt_pd(difference, _mm_loadu_pd(band + k)));
+    };
+    for (; j + 8 <= n; j += 8) {
+        auto const byte = pair(j) | pair(j + 2) << 2 | pair(j + 4) << 4 | pair(j + 6) << 6;
+        bits |= std::uint64_t(byte) << j;
+    }
+#endif
+    for (; j < n; ++j)
+        bits |= std::uint64_t{std::abs(values[j] - last[j]) > band[j]} << j;
+    return bits;
+}
+
+// Bit j is set if error j differs from last[j], or from 0 if last is null, for
+// n <= 64 errors
+std::uint64_t error_changes(int const* errors, int const* last, std::size_t n)
+{
+    std::uint64_t bits = 0;
+    std::size_t j = 0;
+#ifdef SENSORS_CPP_SSE2
+    auto const load = [](int const* p) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(p)); };
+    auto const quad = [&](std::size_t k) {
+        auto const equal = _mm_cmpeq_epi32(load(errors + k), last ? load(last + k) : _mm_setzero_si128());
+        return _mm_movemask_ps(_mm_castsi128_ps(equal)) ^ 0xF;
+    };
+    for (; j + 8 <= n; j += 8)
+        bits |= std::uint64_t(quad(j) | quad(j + 4) << 4) << j;
+#endif
+    for (; j < n; ++j)
+        bits |= std::uint64_t{errors[j] != (last ? last[j] : 0)} << j;
+    return bits;
+}
+
+} // anonymous namespace
+
+change_filter::change_filter(std::size_t size)
+    : m_size{size}
+    , m_values{new double[size]()}
+    , m_errors{new int[size]}
+    , m_times{new clock::time_point[size]}
+    , m_absolute{new double[size]()}
+    , m_relative{new double[size]()}
+    , m_bands{new double[size]()}
+    , m_mask{new std::uint64_t[mask_words()]()}
+{
+    reset();
+}
+
+change_filter::~change_filter() = default;
+
+void change_filter::set_deadband(std::size_t index, double absolute, double relative)
+{
+    if (index >= m_size)
+        throw std::out_of_range{"Change filter index out of range"};
+    if (!(absolute >= 0 && relative >= 0))
+        throw std::invalid_argument{"Deadbands must not be negative"};
+    m_absolute[index] = absolute;
+    m_relative[index] = relative;
+    update_band(index);
+}
+
+void change_filter::set_deadband(double absolute, double relative)
+{
+    if (!(absolute >= 0 && relative >= 0))
+        throw std::invalid_argument{"Deadbands must not be negative"};
+    std::fill_n(m_absolute.get(), m_size, absolute);
+    std::fill_n(m_relative.get(), m_size, relative);
+    for (std::size_t i = 0; i < m_size; ++i)
+        update_band(i);
+}
+
+void change_filter::update_band(std::size_t index)
+{
+    m_bands[index] = std::max(m_absolute[index], m_relative[index] * std::abs(m_values[index]));
+}
+
+void change_filter::set_heartbeat(clock::duration interval)
+{
+    m_heartbeat = interval > clock::duration::zero() ? interval : clock::duration::max();
+}
+
+void change_filter::reset()
+{
+    std::fill_n(m_errors.get(), m_size, never);
+}
+
+std::size_t change_filter::update(double const* values, int const* errors, clock::time_point now)
+{
+    return update(values, errors, nullptr, now);
+}
+
+std::size_t change_filter::update(snapshot const& snap)
+{
+    if (snap.size() != m_size)
+        throw std::invalid_argument{"Snapshot size differs from that of the change filter"};
+    return update(snap.values().data(), snap.errors().data(), snap.times().data(), {});
+}
+
+std::size_t change_filter::update(double const* values, int const* errors, clock::time_point const* times, clock::time_point now)
+{
+    m_count = 0;
+    for (std::size_t first = 0; first < m_size; first += 64) {
+        // Compare a word's worth of entries at once, then record the few that
+        // changed. A value counts only if it was read successfully, and any
+        // change of error code counts, including from or to success.
+        auto const n = std::min<std::size_t>(64, m_size - first);
+        auto bits = value_changes(values + first, &m_values[first], &m_bands[first], n);
+        if (errors) {
+            bits &= ~error_changes(errors + first, nullptr, n);
+            bits |= error_changes(errors + first, &m_errors[first], n);
+        } else {
+            bits |= error_changes(&m_errors[first], nullptr, n);
+        }
+        if (m_heartbeat != clock::duration::max()) {
+            for (std::size_t j = 0; j < n; ++j) {
+                auto const time = times ? times[first + j] : now;
+                bits |= std::uint64_t{time - m_times[first + j] >= m_heartbeat} << j;
+            }
+        }
+        m_mask[first / 64] = bits;
+        m_count += static_cast<std::size_t>(__builtin_popcountll(bits));
+
+        for (; bits; bits &= bits - 1) {
+            auto const i = first + static_cast<std::size_t>(__builtin_ctzll(bits));
+            m_errors[i] = errors ? errors[i] : 0;
+            if (!m_errors[i]) {
+                m_values[i] = values[i];
+                update_band(i);
+            }
+            m_times[i] = times ? times[i] : now;
+        }
+    }
+    return m_count;
+}
+
+} // sensors
@@ -0,0 +1,384 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "sensors-c++/error.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace sensors {
+
+// Recursive descent parser for the grammar of lib/conf-parse.y in lm-sensors,
+// reading one line at a time
+class config_parser
+{
+public:
+    config_parser(config& result) : m_config{result} {}
+
+    void parse(std::FILE* file);
+
+private:
+    enum class token { end, name, number, symbol };
+
+    [[noreturn]] void fail(char const* message) const;
+    token next();
+    bool accept(char symbol);
+    void expect(char symbol);
+    std::string name();
+    void statement();
+    void parse_expression(expression& result);
+    int additive(expression& result);
+    int multiplicative(expression& result);
+    int unary(expression& result);
+    int add_node(expression& result, expression::node node);
+    config::chip_statement& current_chip(char const* statement);
+
+    config& m_config;
+    std::string m_line;
+    std::size_t m_pos = 0;
+    unsigned m_line_number = 0;
+
+    // The current token
+    token m_token = token::end;
+    std::string m_text;
+    double m_number = 0;
+    char m_symbol = 0;
+};
+
+void config_parser::parse(std::FILE* file)
+{
+    char buffer[256];
+    std::string line;
+    unsigned lines = 0;
+    while (std::fgets(buffer, sizeof buffer, file)) {
+        line += buffer;
+        if (line.back() != '\n' && !std::feof(file))
+            continue;
+        ++lines;
+        if (line.back() == '\n')
+            line.pop_back();
+        // A backslash at the end of a line continues the statement
+        if (!line.empty() && line.back() == '\\') {
+            line.back() = ' ';
+            continue;
+        }
+        m_line = std::move(line);
+        line.clear();
+        m_pos = 0;
+        m_line_number = lines;
+        next();
+        statement();
+    }
+    if (std::ferror(file))
+        throw init_error{"Failed to read config file"};
+}
+
+void config_parser::fail(char const* message) const
+{
+    throw init_error{"Config file line " + std::to_string(m_line_number) + ": " + message};
+}
+
+// See lib/conf-lex.l
+auto config_parser::next() -> token
+{
+    while (m_pos < m_line.size() && std::isspace(static_cast<unsigned char>(m_line[m_pos])))
+        ++m_pos;
+    if (m_pos == m_line.size() || m_line[m_pos] == '#')
+        return m_token = token::end;
+
+    auto const c = m_line[m_pos];
+    if (c == '"') {
+        m_text.clear();
+        for (++m_pos; m_pos < m_line.size() && m_line[m_pos] != '"'; ++m_pos) {
+            if (m_line[m_pos] == '\\' && ++m_pos < m_line.size()) {
+                switch (m_line[m_pos]) {
+                case 'n': m_text += '\n'; break;
+                case 't': m_text += '\t'; break;
+                default: m_text += m_line[m_pos];
+                }
+            } else {
+                m_text += m_line[m_pos];
+            }
+        }
+        if (m_pos++ == m_line.size())
+            fail("Unterminated string");
+        return m_token = token::name;
+    }
+    if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+        char* end;
+        m_number = std::strtod(m_line.c_str() + m_pos, &end);
+        m_pos = end - m_line.c_str();
+        return m_token = token::number;
+    }
+    if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+        auto const start = m_pos;
+        while (m_pos < m_line.size() && (std::isalnum(static_cast<unsigned char>(m_line[m_pos])) || m_line[m_pos] == '_'))
+            ++m_pos;
+        m_text = m_line.substr(start, m_pos - start);
+        return m_token = token::name;
+    }
+    if (!std::strchr("+-*/(),@^`", c))
+        fail("Invalid character");
+    m_symbol = c;
+    ++m_pos;
+    return m_token = token::symbol;
+}
+
+bool config_parser::accept(char symbol)
+{
+    if (m_token != token::symbol || m_symbol != symbol)
+        return false;
+    next();
+    return true;
+}
+
+void config_parser::expect(char symbol)
+{
+    if (!accept(symbol))
+        fail("Syntax error");
+}
+
+std::string config_parser::name()
+{
+    if (m_token != token::name)
+        fail("Syntax error");
+    auto result = std::move(m_text);
+    next();
+    return result;
+}
+
+config::chip_statement& config_parser::current_chip(char const* statement)
+{
+    if (m_config.m_chips.empty())
+        fail((statement + std::string{" statement before first chip statement"}).c_str());
+    return m_config.m_chips.back();
+}
+
+void config_parser::statement()
+{
+    if (m_token == token::end)
+        return;
+    auto const keyword = name();
+    if (keyword == "chip") {
+        config::chip_statement chip;
+        do {
+            auto const pattern = name();
+            sensors_chip_name parsed;
+            if (sensors_parse_chip_name(pattern.c_str(), &parsed))
+                fail("Invalid chip name");
+            chip.patterns.push_back(parsed);
+        } while (m_token == token::name);
+        m_config.m_chips.push_back(std::move(chip));
+    } else if (keyword == "label") {
+        auto& chip = current_chip("Label");
+        auto feature = name();
+        chip.labels.emplace_back(std::move(feature), name());
+    } else if (keyword == "compute") {
+        auto& chip = current_chip("Compute");
+        compute_rule rule;
+        auto feature = name();
+        parse_expression(rule.from);
+        expect(',');
+        parse_expression(rule.to);
+        chip.computes.emplace_back(std::move(feature), std::move(rule));
+    } else if (keyword == "ignore") {
+        current_chip("Ignore").ignores.push_back(name());
+    } else if (keyword == "set") {
+        current_chip("Set");
+        name();
+        expression unused;
+        parse_expression(unused);
+    } else if (keyword == "bus") {
+        auto const bus = name();
+        sensors_bus_id id;
+        if (std::sscanf(bus.c_str(), "i2c-%hd", &id.nr) != 1)
+            fail("Invalid bus name");
+        name();
+        m_config.m_bus_statements = true;
+    } else {
+        fail("Syntax error");
+    }
+    if (m_token != token::end)
+        fail("Syntax error");
+}
+
+// expression: additive
+// additive: multiplicative (('+' | '-') multiplicative)*
+// multiplicative: unary (('*' | '/') unary)*
+// unary: ('-' | '^' | '`') unary | number | name | '@' | '(' additive ')'
+void config_parser::parse_expression(expression& result)
+{
+    additive(result);
+}
+
+int config_parser::additive(expression& result)
+{
+    auto left = multiplicative(result);
+    for (;;) {
+        auto op = expression::node::operation::add;
+        if (!accept('+')) {
+            if (!accept('-'))
+                return left;
+            op = expression::node::operation::subtract;
+        }
+        auto const right = multiplicative(result);
+        left = add_node(result, {op, 0, left, right});
+    }
+}
+
+int config_parser::multiplicative(expression& result)
+{
+    auto left = unary(result);
+    for (;;) {
+        auto op = expression::node::operation::multiply;
+        if (!accept('*')) {
+            if (!accept('/'))
+                return left;
+            op = expression::node::operation::divide;
+        }
+        auto const right = unary(result);
+        left = add_node(result, {op, 0, left, right});
+    }
+}
+
+int config_parser::unary(expression& result)
+{
+    using operation = expression::node::operation;
+    if (accept('-'))
+        return add_node(result, {operation::negate, 0, unary(result), -1});
+    if (accept('^'))
+        return add_node(result, {operation::exp, 0, unary(result), -1});
+    if (accept('`'))
+        return add_node(result, {operation::log, 0, unary(result), -1});
+    if (accept('@'))
+        return add_node(result, {operation::source, 0, -1, -1});
+    if (accept('(')) {
+        auto const inner = additive(result);
+        expect(')');
+        return inner;
+    }
+    if (m_token == token::number) {
+        auto const number = m_number;
+        next();
+        return add_node(result, {operation::number, number, -1, -1});
+    }
+    auto const variable = static_cast<int>(result.m_variables.size());
+    result.m_variables.push_back(name());
+    return add_node(result, {operation::variable, 0, variable, -1});
+}
+
+int config_parser::add_node(expression& result, expression::node node)
+{
+    result.m_nodes.push_back(node);
+    return static_cast<int>(result.m_nodes.size()) - 1;
+}
+
+config::config(std::FILE* file)
+{
+    try {
+        append(file);
+    } catch (...) {
+        clear();
+        throw;
+    }
+}
+
+void config::append(std::FILE* file)
+{
+    config_parser{*this}.parse(file);
+}
+
+config::~config()
+{
+    clear();
+}
+
+void config::clear()
+{
+    for (auto& chip : m_chips)
+        for (auto& pattern : chip.patterns)
+            sensors_free_chip_name(&pattern);
+    m_chips.clear();
+}
+
+bool match_chip(sensors_chip_name const& pattern, sensors_chip_name const& chip)
+{
+    if (pattern.prefix != SENSORS_CHIP_NAME_PREFIX_ANY && std::strcmp(pattern.prefix, chip.prefix))
+        return false;
+    if (pattern.bus.type != SENSORS_BUS_TYPE_ANY && pattern.bus.type != chip.bus.type)
+        return false;
+    if (pattern.bus.nr != SENSORS_BUS_NR_ANY && pattern.bus.nr != chip.bus.nr)
+        return false;
+    return pattern.addr == SENSORS_CHIP_NAME_ADDR_ANY || pattern.addr == chip.addr;
+}
+
+bool config::chip_statement::matches(sensors_chip_name const& chip) const
+{
+    for (auto const& pattern : patterns)
+        if (match_chip(pattern, chip))
+            return true;
+    return false;
+}
+
+// Search the chip statements from last to first, like
+// sensors_for_all_config_chips()
+template<typename Result, typename Find>
+Result config::find(sensors_chip_name const& chip, Find const& find) const
+{
+    for (auto it = m_chips.rbegin(); it != m_chips.rend(); ++it)
+        if (it->matches(chip))
+            if (auto const result = find(*it))
+                return result;
+    return {};
+}
+
+char const* config::label(sensors_chip_name const& chip, char const* feature) const
+{
+    return find<char const*>(chip, [&](chip_statement const& statement) -> char const* {
+        for (auto const& [name, label] : statement.labels)
+            if (name == feature)
+                return label.c_str();
+        return nullptr;
+    });
+}
+
+compute_rule const* config::compute(sensors_chip_name const& chip, char const* feature) const
+{
+    return find<compute_rule const*>(chip, [&](chip_statement const& statement) -> compute_rule const* {
+        for (auto const& [name, rule] : statement.computes)
+            if (name == feature)
+                return &rule;
+        return nullptr;
+    });
+}
+
+bool config::ignored(sensors_chip_name const& chip, char const* feature) const
+{
+    return find<bool>(chip, [&](chip_statement const& statement) {
+        for (auto const& name : statement.ignores)
+            if (name == feature)
+                return true;
+        return false;
+    });
+}
+
+} // sensors
@@ -0,0 +1,190 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_CONFIG_H
+#define LIBSENSORS_CPP_CONFIG_H
+
+#include <sensors/sensors.h>
+#include <sensors/error.h>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace sensors {
+
+// An expression of a compute statement, see sensors.conf(5). It is evaluated
+// with the raw or the user's value as @ and may refer to other subfeatures of
+// the chip by name.
+class expression
+{
+public:
+    // Names of the subfeatures the expression refers to, by variable index
+    std::vector<std::string> const& variables() const
+    {
+        return m_variables;
+    }
+
+    // Evaluate the expression. variable(index, value) reads the value of a
+    // variable and returns 0 or a negative libsensors error code, like this
+    // function. See sensors_eval_expr().
+    template<typename Variable>
+    int evaluate(double at, double& result, Variable const& variable) const
+    {
+        return evaluate(static_cast<int>(m_nodes.size()) - 1, at, result, variable);
+    }
+
+private:
+    friend class config_parser;
+
+    struct node
+    {
+        enum class operation { number, source, variable, add, subtract, multiply, divide, negate, exp, log };
+        operation op;
+        double number;
+        // Operand indices, or the variable index in left; -1 if unused
+        int left;
+        int right;
+    };
+
+    template<typename Variable>
+    int evaluate(int i, double at, double& result, Variable const& variable) const;
+
+    // In postfix order, so the root is the last node
+    std::vector<node> m_nodes;
+    std::vector<std::string> m_variables;
+};
+
+struct compute_rule
+{
+    expression from;
+    expression to;
+};
+
+// Whether a chip matches a pattern parsed by sensors_parse_chip_name(), see
+// sensors_match_chip()
+bool match_chip(sensors_chip_name const& pattern, sensors_chip_name const& chip);
+
+// The statements of a libsensors configuration file that the native backend
+// applies: chip, label, compute and ignore. Bus statements are checked but not
+// applied, so I2C bus numbers in chip statements are those of the system, and
+// set statements are ignored like sensors_init() does.
+class config
+{
+public:
+    // An empty configuration
+    config() = default;
+
+    // Parse a configuration file. Throws a sensors::init_error with the line
+    // number of the first syntax error.
+    explicit config(std::FILE* file);
+    ~config();
+
+    config(config const&) = delete;
+    config& operator=(config const&) = delete;
+
+    // Parse another configuration file, whose chip statements follow those
+    // parsed before, like the files sensors_init() reads from /etc/sensors.d.
+    // Throws like the constructor.
+    void append(std::FILE* file);
+
+    // Whether there is a bus statement. libsensors renumbers the I2C buses of
+    // chip statements by these, which this class does not.
+    bool has_bus_statements() const
+    {
+        return m_bus_statements;
+    }
+
+    // The statements that apply to a feature, in the last matching chip
+    // statement that has one. Returns nullptr or false if there is none.
+    char const* label(sensors_chip_name const& chip, char const* feature) const;
+    compute_rule const* compute(sensors_chip_name const& chip, char const* feature) const;
+    bool ignored(sensors_chip_name const& chip, char const* feature) const;
+
+private:
+    friend class config_parser;
+
+    struct chip_statement
+    {
+        std::vector<sensors_chip_name> patterns;
+        std::vector<std::pair<std::string, std::string>> labels;
+        std::vector<std::pair<std::string, compute_rule>> computes;
+        std::vector<std::string> ignores;
+
+        bool matches(sensors_chip_name const& chip) const;
+    };
+
+    // Free the chip names of the patterns
+    void clear();
+
+    template<typename Result, typename Find>
+    Result find(sensors_chip_name const& chip, Find const& find) const;
+
+    std::vector<chip_statement> m_chips;
+    bool m_bus_statements = false;
+};
+
+template<typename Variable>
+int expression::evaluate(int i, double at, double& result, Variable const& variable) const
+{
+    auto const& n = m_nodes[i];
+    double left = 0, right = 0;
+    int error = 0;
+    switch (n.op) {
+    case node::operation::number:
+        result = n.number;
+        return 0;
+    case node::operation::source:
+        result = at;
+        return 0;
+    case node::operation::variable:
+        return variable(n.left, result);
+    default:
+        if ((error = evaluate(n.left, at, left, variable)))
+            return error;
+        if (n.right >= 0 && (error = evaluate(n.right, at, right, variable)))
+            return error;
+    }
+
+    switch (n.op) {
+    case node::operation::add: result = left + right; break;
+    case node::operation::subtract: result = left - right; break;
+    case node::operation::multiply: result = left * right; break;
+    case node::operation::divide:
+        if (right == 0)
+            return -SENSORS_ERR_DIV_ZERO;
+        result = left / right;
+        break;
+    case node::operation::negate: result = -left; break;
+    case node::operation::exp: result = std::exp(left); break;
+    case node::operation::log:
+        if (left < 0)
+            return -SENSORS_ERR_DIV_ZERO;
+        result = std::log(left);
+        break;
+    default: break;
+    }
+    return 0;
+}
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_CONFIG_H
@@ -25,3 +25,32 @@ sensors::error::error(int error)
     : std::runtime_error{sensors_strerror(error)}
 {
 }
+
+namespace {
+
+class libsensors_category_impl : public std::error_category
+{
+public:
+    char const* name() const noexcept override
+    {
+        return "libsensors";
+    }
+
+    std::string message(int code) const override
+    {
+        return sensors_strerror(code);
+    }
+};
+
+} // anonymous namespace
+
+std::error_category const& sensors::libsensors_category() noexcept
+{
+    static libsensors_category_impl const category;
+    return category;
+}
+
+std::error_code sensors::make_error_code(errc code) noexcept
+{
+    return {static_cast<int>(code), libsensors_category()};
+}
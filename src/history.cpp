@@ -0,0 +1,146 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sensors-c++/history.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace sensors {
+
+history::history(std::size_t capacity)
+    : m_capacity{capacity}
+    , m_times{capacity ? new clock::time_point[capacity] : nullptr}
+    , m_values{capacity ? new double[capacity] : nullptr}
+{
+    if (!capacity)
+        throw std::invalid_argument{"History capacity must be positive"};
+}
+
+history::~history() = default;
+
+std::size_t history::physical(std::size_t i) const
+{
+    auto const index = m_start + i;
+    return index < m_capacity ? index : index - m_capacity;
+}
+
+void history::push(clock::time_point time, double value)
+{
+    if (m_size)
+        time = std::max(time, m_times[physical(m_size - 1)]);
+    std::size_t index;
+    if (m_size < m_capacity) {
+        index = physical(m_size++);
+    } else {
+        index = m_start;
+        m_start = physical(1);
+    }
+    m_times[index] = time;
+    m_values[index] = value;
+}
+
+void history::clear()
+{
+    m_start = 0;
+    m_size = 0;
+}
+
+history::clock::time_point history::time(std::size_t i) const
+{
+    return m_times[physical(i)];
+}
+
+double history::value(std::size_t i) const
+{
+    return m_values[physical(i)];
+}
+
+// Index of the first entry at or after time
+std::size_t history::lower_bound(clock::time_point time) const
+{
+    std::size_t first = 0, count = m_size;
+    while (count) {
+        auto const half = count / 2;
+        if (m_times[physical(first + half)] < time) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first;
+}
+
+auto history::slice(std::size_t first, std::size_t last) const -> window
+{
+    window w {};
+    if (first >= last)
+        return w;
+    auto const begin = physical(first);
+    auto const contiguous = std::min(last - first, m_capacity - begin);
+    w.first = {&m_times[begin], &m_values[begin], contiguous};
+    if (contiguous < last - first)
+        w.second = {&m_times[0], &m_values[0], last - first - contiguous};
+    return w;
+}
+
+auto history::all() const -> window
+{
+    return slice(0, m_size);
+}
+
+auto history::range(clock::time_point from, clock::time_point to) const -> window
+{
+    if (!(from < to))
+        return {};
+    return slice(lower_bound(from), lower_bound(to));
+}
+
+std::size_t history::copy(clock::time_point from, clock::time_point to, clock::time_point* times,
+                          double* values) const
+{
+    auto const w = range(from, to);
+    for (auto const& s : {w.first, w.second}) {
+        if (times)
+            times = std::copy_n(s.times, s.size, times);
+        if (values)
+            values = std::copy_n(s.values, s.size, values);
+    }
+    return w.size();
+}
+
+void history::assign(history const& other)
+{
+    if (&other == this)
+        return;
+    auto const count = std::min(other.m_size, m_capacity);
+    auto const w = other.slice(other.m_size - count, other.m_size);
+    auto times = &m_times[0];
+    auto values = &m_values[0];
+    for (auto const& s : {w.first, w.second}) {
+        times = std::copy_n(s.times, s.size, times);
+        values = std::copy_n(s.values, s.size, values);
+    }
+    m_start = 0;
+    m_size = count;
+}
+
+} // sensors
@@ -0,0 +1,584 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "hwmon.h"
+#include "impl.h"
+#include "config.h"
+#include "sensors-c++/error.h"
+#include <sensors/error.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sensors {
+
+namespace {
+
+// Channel numbers libsensors accepts per feature type, counting from 0
+constexpr int max_channels = 1024;
+
+struct suffix
+{
+    char const* name;
+    sensors_subfeature_type type;
+};
+
+constexpr suffix temp_suffixes[] = {
+    {"input", SENSORS_SUBFEATURE_TEMP_INPUT},
+    {"max", SENSORS_SUBFEATURE_TEMP_MAX},
+    {"max_hyst", SENSORS_SUBFEATURE_TEMP_MAX_HYST},
+    {"min", SENSORS_SUBFEATURE_TEMP_MIN},
+    {"min_hyst", SENSORS_SUBFEATURE_TEMP_MIN_HYST},
+    {"crit", SENSORS_SUBFEATURE_TEMP_CRIT},
+    {"crit_hyst", SENSORS_SUBFEATURE_TEMP_CRIT_HYST},
+    {"lcrit", SENSORS_SUBFEATURE_TEMP_LCRIT},
+    {"lcrit_hyst", SENSORS_SUBFEATURE_TEMP_LCRIT_HYST},
+    {"emergency", SENSORS_SUBFEATURE_TEMP_EMERGENCY},
+    {"emergency_hyst", SENSORS_SUBFEATURE_TEMP_EMERGENCY_HYST},
+    {"lowest", SENSORS_SUBFEATURE_TEMP_LOWEST},
+    {"highest", SENSORS_SUBFEATURE_TEMP_HIGHEST},
+    {"alarm", SENSORS_SUBFEATURE_TEMP_ALARM},
+    {"min_alarm", SENSORS_SUBFEATURE_TEMP_MIN_ALARM},
+    {"max_alarm", SENSORS_SUBFEATURE_TEMP_MAX_ALARM},
+    {"crit_alarm", SENSORS_SUBFEATURE_TEMP_CRIT_ALARM},
+    {"emergency_alarm", SENSORS_SUBFEATURE_TEMP_EMERGENCY_ALARM},
+    {"lcrit_alarm", SENSORS_SUBFEATURE_TEMP_LCRIT_ALARM},
+    {"fault", SENSORS_SUBFEATURE_TEMP_FAULT},
+    {"type", SENSORS_SUBFEATURE_TEMP_TYPE},
+    {"offset", SENSORS_SUBFEATURE_TEMP_OFFSET},
+    {"beep", SENSORS_SUBFEATURE_TEMP_BEEP},
+};
+
+constexpr suffix in_suffixes[] = {
+    {"input", SENSORS_SUBFEATURE_IN_INPUT},
+    {"min", SENSORS_SUBFEATURE_IN_MIN},
+    {"max", SENSORS_SUBFEATURE_IN_MAX},
+    {"lcrit", SENSORS_SUBFEATURE_IN_LCRIT},
+    {"crit", SENSORS_SUBFEATURE_IN_CRIT},
+    {"average", SENSORS_SUBFEATURE_IN_AVERAGE},
+    {"lowest", SENSORS_SUBFEATURE_IN_LOWEST},
+    {"highest", SENSORS_SUBFEATURE_IN_HIGHEST},
+    {"alarm", SENSORS_SUBFEATURE_IN_ALARM},
+    {"min_alarm", SENSORS_SUBFEATURE_IN_MIN_ALARM},
+    {"max_alarm", SENSORS_SUBFEATURE_IN_MAX_ALARM},
+    {"lcrit_alarm", SENSORS_SUBFEATURE_IN_LCRIT_ALARM},
+    {"crit_alarm", SENSORS_SUBFEATURE_IN_CRIT_ALARM},
+    {"beep", SENSORS_SUBFEATURE_IN_BEEP},
+};
+
+constexpr suffix fan_suffixes[] = {
+    {"input", SENSORS_SUBFEATURE_FAN_INPUT},
+    {"min", SENSORS_SUBFEATURE_FAN_MIN},
+    {"max", SENSORS_SUBFEATURE_FAN_MAX},
+    {"alarm", SENSORS_SUBFEATURE_FAN_ALARM},
+    {"fault", SENSORS_SUBFEATURE_FAN_FAULT},
+    {"div", SENSORS_SUBFEATURE_FAN_DIV},
+    {"beep", SENSORS_SUBFEATURE_FAN_BEEP},
+    {"pulses", SENSORS_SUBFEATURE_FAN_PULSES},
+    {"min_alarm", SENSORS_SUBFEATURE_FAN_MIN_ALARM},
+    {"max_alarm", SENSORS_SUBFEATURE_FAN_MAX_ALARM},
+};
+
+constexpr suffix cpu_suffixes[] = {
+    {"vid", SENSORS_SUBFEATURE_VID},
+};
+
+constexpr suffix power_suffixes[] = {
+    {"average", SENSORS_SUBFEATURE_POWER_AVERAGE},
+    {"average_highest", SENSORS_SUBFEATURE_POWER_AVERAGE_HIGHEST},
+    {"average_lowest", SENSORS_SUBFEATURE_POWER_AVERAGE_LOWEST},
+    {"input", SENSORS_SUBFEATURE_POWER_INPUT},
+    {"input_highest", SENSORS_SUBFEATURE_POWER_INPUT_HIGHEST},
+    {"input_lowest", SENSORS_SUBFEATURE_POWER_INPUT_LOWEST},
+    {"cap", SENSORS_SUBFEATURE_POWER_CAP},
+    {"cap_hyst", SENSORS_SUBFEATURE_POWER_CAP_HYST},
+    {"cap_alarm", SENSORS_SUBFEATURE_POWER_CAP_ALARM},
+    {"alarm", SENSORS_SUBFEATURE_POWER_ALARM},
+    {"max", SENSORS_SUBFEATURE_POWER_MAX},
+    {"max_alarm", SENSORS_SUBFEATURE_POWER_MAX_ALARM},
+    {"min", SENSORS_SUBFEATURE_POWER_MIN},
+    {"min_alarm", SENSORS_SUBFEATURE_POWER_MIN_ALARM},
+    {"lcrit", SENSORS_SUBFEATURE_POWER_LCRIT},
+    {"lcrit_alarm", SENSORS_SUBFEATURE_POWER_LCRIT_ALARM},
+    {"crit", SENSORS_SUBFEATURE_POWER_CRIT},
+    {"crit_alarm", SENSORS_SUBFEATURE_POWER_CRIT_ALARM},
+    {"average_interval", SENSORS_SUBFEATURE_POWER_AVERAGE_INTERVAL},
+};
+
+constexpr suffix curr_suffixes[] = {
+    {"input", SENSORS_SUBFEATURE_CURR_INPUT},
+    {"min", SENSORS_SUBFEATURE_CURR_MIN},
+    {"max", SENSORS_SUBFEATURE_CURR_MAX},
+    {"lcrit", SENSORS_SUBFEATURE_CURR_LCRIT},
+    {"crit", SENSORS_SUBFEATURE_CURR_CRIT},
+    {"average", SENSORS_SUBFEATURE_CURR_AVERAGE},
+    {"lowest", SENSORS_SUBFEATURE_CURR_LOWEST},
+    {"highest", SENSORS_SUBFEATURE_CURR_HIGHEST},
+    {"alarm", SENSORS_SUBFEATURE_CURR_ALARM},
+    {"min_alarm", SENSORS_SUBFEATURE_CURR_MIN_ALARM},
+    {"max_alarm", SENSORS_SUBFEATURE_CURR_MAX_ALARM},
+    {"lcrit_alarm", SENSORS_SUBFEATURE_CURR_LCRIT_ALARM},
+    {"crit_alarm", SENSORS_SUBFEATURE_CURR_CRIT_ALARM},
+    {"beep", SENSORS_SUBFEATURE_CURR_BEEP},
+};
+
+constexpr suffix energy_suffixes[] = {
+    {"input", SENSORS_SUBFEATURE_ENERGY_INPUT},
+};
+
+constexpr suffix intrusion_suffixes[] = {
+    {"alarm", SENSORS_SUBFEATURE_INTRUSION_ALARM},
+    {"beep", SENSORS_SUBFEATURE_INTRUSION_BEEP},
+};
+
+constexpr suffix humidity_suffixes[] = {
+    {"input", SENSORS_SUBFEATURE_HUMIDITY_INPUT},
+};
+
+struct type_match
+{
+    char const* format;
+    suffix const* first;
+    suffix const* last;
+};
+
+template<std::size_t N>
+constexpr type_match match(char const* format, suffix const (&suffixes)[N])
+{
+    return {format, suffixes, suffixes + N};
+}
+
+constexpr type_match type_matches[] = {
+    match("temp%d%c", temp_suffixes),
+    match("in%d%c", in_suffixes),
+    match("fan%d%c", fan_suffixes),
+    match("cpu%d%c", cpu_suffixes),
+    match("power%d%c", power_suffixes),
+    match("curr%d%c", curr_suffixes),
+    match("energy%d%c", energy_suffixes),
+    match("intrusion%d%c", intrusion_suffixes),
+    match("humidity%d%c", humidity_suffixes),
+};
+
+// Type and channel number of an attribute file, see sensors_subfeature_get_type()
+sensors_subfeature_type attribute_type(char const* name, int& nr)
+{
+    if (!std::strcmp(name, "beep_enable")) {
+        nr = 0;
+        return SENSORS_SUBFEATURE_BEEP_ENABLE;
+    }
+
+    for (auto const& m : type_matches) {
+        char c;
+        auto const count = std::sscanf(name, m.format, &nr, &c);
+        if (!count)
+            continue;
+        if (count != 2 || c != '_')
+            break;
+        auto const suffix = std::strchr(name + 3, '_') + 1;
+        auto const it = std::find_if(m.first, m.last, [&](auto const& s) { return !std::strcmp(suffix, s.name); });
+        return it != m.last ? it->type : SENSORS_SUBFEATURE_UNKNOWN;
+    }
+    return SENSORS_SUBFEATURE_UNKNOWN;
+}
+
+// First line of an attribute without its last character, see sysfs_read_attr()
+bool read_attribute(std::string const& dir, char const* name, std::string& value)
+{
+    auto const file = std::fopen((dir + '/' + name).c_str(), "r");
+    if (!file)
+        return false;
+    char buffer[256];
+    auto const line = std::fgets(buffer, sizeof buffer, file);
+    std::fclose(file);
+    if (!line)
+        return false;
+    value.assign(buffer, std::strlen(buffer) - 1);
+    return true;
+}
+
+bool read_link(std::string const& path, std::string& target)
+{
+    char buffer[PATH_MAX];
+    auto const size = ::readlink(path.c_str(), buffer, sizeof buffer - 1);
+    if (size < 0)
+        return false;
+    target.assign(buffer, size);
+    return true;
+}
+
+bool real_path(std::string const& path, std::string& resolved)
+{
+    std::unique_ptr<char, void (*)(void*)> result {::realpath(path.c_str(), nullptr), std::free};
+    if (!result)
+        return false;
+    resolved = result.get();
+    return true;
+}
+
+char const* base_name(std::string const& path)
+{
+    auto const slash = path.rfind('/');
+    return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+// A detected chip with its features and subfeatures, like libsensors' struct
+// sensors_chip_features. The string members of the libsensors structs point
+// into the storage members once the chip is complete.
+struct hwmon_chip : sensors_chip_name
+{
+    std::string m_prefix;
+    std::string m_path;
+    std::vector<sensors_feature> m_features;
+    std::vector<sensors_subfeature> m_subfeatures;
+    std::deque<std::string> m_names;
+};
+
+class hwmon_scan : public enumeration
+{
+public:
+    hwmon_scan(std::string_view sysfs_root, config const* config);
+
+    sensors_chip_name const* chip(int& nr) const override
+    {
+        return nr < static_cast<int>(m_chips.size()) ? &m_chips[nr++] : nullptr;
+    }
+
+    // Skips ignored features, like sensors_get_features()
+    sensors_feature const* feature(sensors_chip_name const& chip, int& nr) const override
+    {
+        auto const& features = static_cast<hwmon_chip const&>(chip).m_features;
+        while (nr < static_cast<int>(features.size())) {
+            auto const& feat = features[nr++];
+            if (!m_config || !m_config->ignored(chip, feat.name))
+                return &feat;
+        }
+        return nullptr;
+    }
+
+    sensors_subfeature const* subfeature(sensors_chip_name const& chip, sensors_feature const& feat,
+                                         int& nr) const override
+    {
+        auto const& subfeatures = static_cast<hwmon_chip const&>(chip).m_subfeatures;
+        auto const i = static_cast<std::size_t>(feat.first_subfeature + nr);
+        if (i >= subfeatures.size() || subfeatures[i].mapping != feat.number)
+            return nullptr;
+        ++nr;
+        return &subfeatures[i];
+    }
+
+    // A label statement of the configuration takes precedence
+    std::string label(sensors_chip_name const& chip, sensors_feature const& feat) const override
+    {
+        if (m_config)
+            if (auto const label = m_config->label(chip, feat.name))
+                return label;
+        return hwmon_label(chip, feat);
+    }
+
+private:
+    bool add_chip(std::string const* device_path, std::string const& hwmon_path);
+    bool find_bus(std::string device_path, sensors_chip_name& chip) const;
+    void find_subfeatures(hwmon_chip& chip) const;
+
+    std::string m_root;
+    config const* m_config;
+    std::deque<hwmon_chip> m_chips;
+};
+
+// See sensors_read_sysfs_chips() and sensors_add_hwmon_device()
+hwmon_scan::hwmon_scan(std::string_view sysfs_root, config const* config)
+    : m_root{sysfs_root}, m_config{config}
+{
+    auto const class_path = m_root + "/class/hwmon";
+    std::unique_ptr<DIR, int (*)(DIR*)> dir {::opendir(class_path.c_str()), ::closedir};
+    if (!dir)
+        throw init_error{"Failed to open " + class_path + " (" + std::strerror(errno) + ")"};
+
+    while (auto const entry = ::readdir(dir.get())) {
+        if (entry->d_name[0] == '.')
+            continue;
+        auto const path = class_path + '/' + entry->d_name;
+        std::string device;
+        if (!real_path(path + "/device", device)) {
+            // No device link, treat as virtual
+            add_chip(nullptr, path);
+            continue;
+        }
+        // The attributes may be those of the class device or those of the device
+        if (!add_chip(&device, path))
+            add_chip(&device, device);
+    }
+}
+
+// See sensors_read_one_sysfs_chip()
+bool hwmon_scan::add_chip(std::string const* device_path, std::string const& hwmon_path)
+{
+    hwmon_chip chip {};
+    if (!read_attribute(hwmon_path, "name", chip.m_prefix))
+        return false;
+    chip.m_path = hwmon_path;
+
+    // Devices of unknown type are treated as virtual too
+    if (!device_path || !find_bus(*device_path, chip)) {
+        chip.bus.type = SENSORS_BUS_TYPE_VIRTUAL;
+        chip.bus.nr = 0;
+        chip.addr = 0;
+    }
+
+    find_subfeatures(chip);
+    if (chip.m_subfeatures.empty())
+        return false;
+
+    auto& added = m_chips.emplace_back(std::move(chip));
+    added.prefix = added.m_prefix.data();
+    added.path = added.m_path.data();
+    return true;
+}
+
+// Set the bus and address of a chip from its device or the first of its parents
+// of a known type. Returns false if there is none. See find_bus_type().
+bool hwmon_scan::find_bus(std::string device_path, sensors_chip_name& chip) const
+{
+    for (;;) {
+        auto const name = base_name(device_path);
+        std::string subsystem_path;
+        char const* subsystem = nullptr;
+        if (read_link(device_path + "/subsystem", subsystem_path)
+                || (errno == ENOENT && read_link(device_path + "/bus", subsystem_path)))
+            subsystem = base_name(subsystem_path);
+        else if (errno != ENOENT)
+            return false;
+        auto const is = [&](char const* type) { return !subsystem || !std::strcmp(subsystem, type); };
+
+        unsigned address, domain, bus, slot, fn, vendor, product, id;
+        int channel, target;
+        if (is("i2c") && std::sscanf(name, "%hd-%x", &chip.bus.nr, &address) == 2) {
+            chip.addr = address;
+            // Find out if this is legacy ISA or not
+            chip.bus.type = SENSORS_BUS_TYPE_I2C;
+            std::string adapter;
+            auto const adapter_path = m_root + "/class/i2c-adapter/i2c-" + std::to_string(chip.bus.nr) + "/device";
+            if (chip.bus.nr == 9191 || (read_attribute(adapter_path, "name", adapter) && !adapter.compare(0, 4, "ISA "))) {
+                chip.bus.type = SENSORS_BUS_TYPE_ISA;
+                chip.bus.nr = 0;
+            }
+        } else if (is("spi") && std::sscanf(name, "spi%hd.%d", &chip.bus.nr, &chip.addr) == 2) {
+            chip.bus.type = SENSORS_BUS_TYPE_SPI;
+        } else if (is("pci") && std::sscanf(name, "%x:%x:%x.%x", &domain, &bus, &slot, &fn) == 4) {
+            chip.addr = (domain << 16) + (bus << 8) + (slot << 3) + fn;
+            chip.bus.type = SENSORS_BUS_TYPE_PCI;
+            chip.bus.nr = 0;
+        } else if (!subsystem || is("platform") || is("of_platform")) {
+            // Must be new ISA (platform driver)
+            if (std::sscanf(name, "%*[a-z0-9_].%d", &chip.addr) != 1)
+                chip.addr = 0;
+            chip.bus.type = SENSORS_BUS_TYPE_ISA;
+            chip.bus.nr = 0;
+        } else if (is("acpi")) {
+            chip.bus.type = SENSORS_BUS_TYPE_ACPI;
+            chip.bus.nr = 0;
+            chip.addr = 0;
+        } else if (is("hid") && std::sscanf(name, "%x:%x:%x.%x", &bus, &vendor, &product, &id) == 4) {
+            chip.bus.type = SENSORS_BUS_TYPE_HID;
+            chip.bus.nr = bus;
+            chip.addr = id;
+        } else if (is("mdio_bus")) {
+            if (std::sscanf(name, "%*[^:]:%d", &chip.addr) != 1)
+                chip.addr = 0;
+            chip.bus.type = SENSORS_BUS_TYPE_MDIO;
+            chip.bus.nr = 0;
+        } else if (is("scsi") && std::sscanf(name, "%hd:%d:%d:%x", &chip.bus.nr, &channel, &target, &address) == 4) {
+            chip.addr = (channel << 8) + (target << 4) + address;
+            chip.bus.type = SENSORS_BUS_TYPE_SCSI;
+        } else if (!real_path(device_path + "/device", device_path)) {
+            return false;
+        } else {
+            // Try the parent device
+            continue;
+        }
+        return true;
+    }
+}
+
+// List the subfeatures of a chip and group them into features, in the order
+// libsensors uses: by feature type, channel number and subfeature type. See
+// sensors_read_dynamic_chip().
+void hwmon_scan::find_subfeatures(hwmon_chip& chip) const
+{
+    struct attribute
+    {
+        sensors_subfeature_type type;
+        int nr;
+        std::string name;
+        unsigned flags;
+    };
+    std::vector<attribute> attributes;
+
+    std::unique_ptr<DIR, int (*)(DIR*)> dir {::opendir(chip.m_path.c_str()), ::closedir};
+    if (!dir)
+        return;
+    while (auto const entry = ::readdir(dir.get())) {
+        int nr;
+        auto const type = attribute_type(entry->d_name, nr);
+        if (type == SENSORS_SUBFEATURE_UNKNOWN)
+            continue;
+
+        // Channel numbers of these types start at 1
+        switch (type & 0xFF00) {
+        case SENSORS_SUBFEATURE_FAN_INPUT:
+        case SENSORS_SUBFEATURE_TEMP_INPUT:
+        case SENSORS_SUBFEATURE_POWER_AVERAGE:
+        case SENSORS_SUBFEATURE_ENERGY_INPUT:
+        case SENSORS_SUBFEATURE_CURR_INPUT:
+        case SENSORS_SUBFEATURE_HUMIDITY_INPUT:
+            --nr;
+        }
+        if (nr < 0 || nr >= max_channels)
+            continue;
+
+        unsigned flags = 0;
+        // Other and miscellaneous subfeatures are never scaled
+        if (type < SENSORS_SUBFEATURE_VID && !(type & 0x80))
+            flags |= SENSORS_COMPUTE_MAPPING;
+        struct stat status;
+        if (::stat((chip.m_path + '/' + entry->d_name).c_str(), &status) == 0) {
+            if (status.st_mode & S_IRUSR)
+                flags |= SENSORS_MODE_R;
+            if (status.st_mode & S_IWUSR)
+                flags |= SENSORS_MODE_W;
+        }
+        attributes.push_back({type, nr, entry->d_name, flags});
+    }
+
+    auto const key = [](attribute const& a) { return std::make_tuple(a.type >> 8, a.nr, a.type & 0xFF); };
+    std::sort(attributes.begin(), attributes.end(), [&](auto const& a, auto const& b) { return key(a) < key(b); });
+
+    for (std::size_t i = 0; i < attributes.size(); ++i) {
+        auto const& a = attributes[i];
+        auto const feature_type = static_cast<sensors_feature_type>(a.type >> 8);
+        if (i == 0 || (attributes[i - 1].type >> 8) != feature_type || attributes[i - 1].nr != a.nr) {
+            // Named after the first subfeature, without its suffix for main
+            // features and intrusion
+            auto name = a.name;
+            if (feature_type < SENSORS_FEATURE_MAX_MAIN || feature_type == SENSORS_FEATURE_INTRUSION)
+                name.erase(name.find('_'));
+            sensors_feature feat {};
+            feat.name = chip.m_names.emplace_back(std::move(name)).data();
+            feat.number = static_cast<int>(chip.m_features.size());
+            feat.type = feature_type;
+            feat.first_subfeature = static_cast<int>(chip.m_subfeatures.size());
+            chip.m_features.push_back(feat);
+        }
+        sensors_subfeature sub {};
+        sub.name = chip.m_names.emplace_back(a.name).data();
+        sub.number = static_cast<int>(chip.m_subfeatures.size());
+        sub.type = a.type;
+        sub.mapping = chip.m_features.back().number;
+        sub.flags = a.flags;
+        chip.m_subfeatures.push_back(sub);
+    }
+}
+
+} // anonymous namespace
+
+std::unique_ptr<topology> hwmon_topology(std::string_view sysfs_root, std::shared_ptr<config const> config,
+                                         descriptor_table& descriptors)
+{
+    while (sysfs_root.size() > 1 && sysfs_root.back() == '/')
+        sysfs_root.remove_suffix(1);
+    if (sysfs_root == "/")
+        sysfs_root = {};
+    hwmon_scan const chips {sysfs_root, config.get()};
+    return topology::create(chips, backend::native, sysfs_root, std::move(config), false, &descriptors);
+}
+
+// See sensors_get_label()
+std::string hwmon_label(sensors_chip_name const& chip, sensors_feature const& feature)
+{
+    auto const path = std::string{chip.path} + '/' + feature.name + "_label";
+    if (auto const file = std::fopen(path.c_str(), "r")) {
+        char buffer[128];
+        auto const size = std::fread(buffer, 1, sizeof buffer, file);
+        std::fclose(file);
+        // Strip the newline
+        if (size > 0)
+            return {buffer, size - 1};
+    }
+    return feature.name;
+}
+
+// See sensors_set_value() and sensors_write_sysfs_attr()
+int hwmon_write(sensors_chip_name const& chip, sensors_subfeature const& sub, double value)
+{
+    if (!(sub.flags & SENSORS_MODE_W))
+        return -SENSORS_ERR_ACCESS_W;
+    auto const path = std::string{chip.path} + '/' + sub.name;
+    auto const file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return -SENSORS_ERR_KERNEL;
+    value *= sysfs_scaling(sub.type);
+    if (std::fprintf(file, "%d", static_cast<int>(value)) < 0) {
+        std::fclose(file);
+        return -SENSORS_ERR_ACCESS_W;
+    }
+    // The value is only written out here
+    if (std::fclose(file) == EOF)
+        return errno == EIO ? -SENSORS_ERR_IO : -SENSORS_ERR_ACCESS_W;
+    return 0;
+}
+
+// See sensors_get_adapter_name()
+std::string hwmon_adapter_name(sensors_bus_id const& bus, std::string_view sysfs_root)
+{
+    switch (bus.type) {
+    case SENSORS_BUS_TYPE_ISA: return "ISA adapter";
+    case SENSORS_BUS_TYPE_PCI: return "PCI adapter";
+    case SENSORS_BUS_TYPE_SPI: return "SPI adapter";
+    case SENSORS_BUS_TYPE_VIRTUAL: return "Virtual device";
+    case SENSORS_BUS_TYPE_ACPI: return "ACPI interface";
+    case SENSORS_BUS_TYPE_HID: return "HID adapter";
+    case SENSORS_BUS_TYPE_MDIO: return "MDIO adapter";
+    case SENSORS_BUS_TYPE_SCSI: return "SCSI adapter";
+    }
+
+    // Look for the I2C adapter, see sensors_read_sysfs_bus()
+    auto const adapter = "/i2c-" + std::to_string(bus.nr);
+    std::string name;
+    for (char const* dir : {"/class/i2c-adapter", "/bus/i2c/devices"}) {
+        if (read_attribute(std::string{sysfs_root} + dir + adapter, "name", name))
+            return name;
+    }
+    return {};
+}
+
+} // sensors
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_HWMON_H
+#define LIBSENSORS_CPP_HWMON_H
+
+#include <sensors/sensors.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+// The native backend: counterparts of the libsensors functions the library uses
+// that work on the hwmon class in sysfs directly, see lib/sysfs.c and
+// lib/access.c of lm-sensors
+
+namespace sensors {
+
+class config;
+class descriptor_table;
+class topology;
+
+// Build a topology of the chips in the class/hwmon directory of sysfs_root,
+// detected the way sensors_init() does, with the statements of config if given,
+// whose attribute files are opened through descriptors. Throws a
+// sensors::init_error if that directory cannot be read.
+std::unique_ptr<topology> hwmon_topology(std::string_view sysfs_root, std::shared_ptr<config const> config,
+                                         descriptor_table& descriptors);
+
+// The contents of the feature's _label attribute, or its name
+std::string hwmon_label(sensors_chip_name const& chip, sensors_feature const& feature);
+
+// Write a subfeature. Returns 0 or a negative libsensors error code.
+int hwmon_write(sensors_chip_name const& chip, sensors_subfeature const& sub, double value);
+
+// Description of a bus, which is empty for an I2C bus without adapter name
+std::string hwmon_adapter_name(sensors_bus_id const& bus, std::string_view sysfs_root);
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_HWMON_H
@@ -0,0 +1,332 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_IMPL_H
+#define LIBSENSORS_CPP_IMPL_H
+
+#include "sensors-c++/sensors.h"
+#include "sysfs.h"
+#include <sensors/sensors.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Internal definitions shared by the library's translation units
+
+namespace sensors {
+
+bus_type to_bus_type(short type);
+subfeature_type to_subfeature_type(sensors_subfeature_type type);
+
+constexpr auto subfeature_type_count = static_cast<std::size_t>(subfeature_type::unknown) + 1;
+
+class config;
+class topology;
+
+// Records hold a copy of their libsensors object, with any strings stored in
+// the topology's arena, so that they do not depend on the libsensors state that
+// was current when the topology was built.
+template<typename T>
+struct impl_base
+{
+    impl_base(T const& object, sensors::topology const& topology) : m_object{object}, m_topology{topology} {}
+
+    T const& get() const { return m_object; }
+    operator T const*() const { return &m_object; }
+
+    T m_object;
+    sensors::topology const& m_topology;
+};
+
+// The impl classes are the records of a topology, which handles point to. Their
+// find functions look up a record in the current topology of a context. They
+// take a read_lock on that context that must live until the caller has made a
+// handle of the result, so that a reload cannot free it first.
+using chip_record = _sensors_impl<chip_name>::impl;
+using feature_record = _sensors_impl<feature>::impl;
+using subfeature_record = _sensors_impl<subfeature>::impl;
+
+template<>
+struct _sensors_impl<bus_id>::impl : public impl_base<sensors_bus_id>
+{
+    using impl_base::impl_base;
+
+    // Adapter name for the native backend, read on first use
+    mutable std::once_flag m_adapter_read;
+    mutable std::string m_adapter;
+};
+
+template<>
+struct _sensors_impl<chip_name>::impl : public impl_base<sensors_chip_name>
+{
+    impl(sensors_chip_name const& chip, sensors::topology const& topology)
+        : impl_base{chip, topology}, m_bus{chip.bus, topology}
+    {}
+
+    _sensors_impl<bus_id>::impl m_bus;
+    feature_record const* m_features = nullptr;
+    std::size_t m_feature_count = 0;
+    // Output of sensors_snprintf_chip_name(), or its error code
+    std::string_view m_name;
+    int m_name_error = 0;
+
+    impl static const& find(context const& ctx, std::string_view path, read_lock const& lock);
+};
+
+template<>
+struct _sensors_impl<feature>::impl : public impl_base<sensors_feature>
+{
+    impl(chip_record const& chip, sensors_feature const& feat) : impl_base{feat, chip.m_topology}, m_chip{chip} {}
+
+    chip_record const& m_chip;
+    subfeature_record const* m_subfeatures = nullptr;
+    std::size_t m_subfeature_count = 0;
+    // Subfeatures indexed by subfeature_type
+    std::array<subfeature_record const*, subfeature_type_count> m_by_type {};
+    std::string_view m_label;
+
+    // E.g. /sys/class/hwmon/hwmon0, temp1
+    impl static const& find(context const& ctx, std::string_view chip_path, std::string_view feature_name,
+                            read_lock const& lock);
+};
+
+template<>
+struct _sensors_impl<subfeature>::impl : public impl_base<sensors_subfeature>
+{
+    impl(feature_record const& feat, sensors_subfeature const& sub, bool computed);
+
+    feature_record const& m_feature;
+    sysfs_attribute m_attribute;
+
+    impl static const& find(context const& ctx, std::string_view full_path, read_lock const& lock);
+};
+
+// Source of the objects a topology is built from, iterated the same way as
+// sensors_get_detected_chips(), sensors_get_features() and
+// sensors_get_all_subfeatures(), and of their labels, see sensors_get_label()
+class enumeration
+{
+public:
+    virtual sensors_chip_name const* chip(int& nr) const = 0;
+    virtual sensors_feature const* feature(sensors_chip_name const& chip, int& nr) const = 0;
+    virtual sensors_subfeature const* subfeature(sensors_chip_name const& chip, sensors_feature const& feat,
+                                                 int& nr) const = 0;
+    virtual std::string label(sensors_chip_name const& chip, sensors_feature const& feat) const = 0;
+
+protected:
+    ~enumeration() = default;
+};
+
+// The objects detected by libsensors
+class libsensors_enumeration : public enumeration
+{
+public:
+    sensors_chip_name const* chip(int& nr) const override;
+    sensors_feature const* feature(sensors_chip_name const& chip, int& nr) const override;
+    sensors_subfeature const* subfeature(sensors_chip_name const& chip, sensors_feature const& feat,
+                                         int& nr) const override;
+    std::string label(sensors_chip_name const& chip, sensors_feature const& feat) const override;
+};
+
+// One generation of the chips, features and subfeatures detected by a backend.
+// The records are stored in arrays allocated from a single arena, which is
+// released at once when the topology is destroyed, together with their names
+// and labels, which are looked up once while it is built.
+//
+// Handles point into a topology without owning it. Its context keeps it until
+// the context is destroyed, also after load_config() has replaced it, so that
+// copying a handle touches no shared state. It stays usable once replaced: it
+// holds no pointers into libsensors, which matches the copied objects by name
+// in later calls, and the native backend only needs the paths it contains and
+// its configuration, which the topology keeps.
+class topology
+{
+public:
+    // A chip, or a feature and/or subfeature of a chip, found at a sysfs path
+    struct path_entry
+    {
+        chip_record const* chip;
+        feature_record const* feature;
+        subfeature_record const* subfeature;
+    };
+
+    // Build a topology of the objects of a backend with its configuration, if
+    // any. The native backend applies its compute statements itself. With
+    // libsensors, configured tells whether sensors_init() loaded a
+    // configuration, and config is that configuration unless it could not be
+    // parsed, see computed(). Attribute files are opened through descriptors,
+    // if given, which must outlive the topology.
+    static std::unique_ptr<topology> create(enumeration const& objects, sensors::backend backend,
+                                            std::string_view sysfs_root,
+                                            std::shared_ptr<sensors::config const> config = {},
+                                            bool configured = false, descriptor_table* descriptors = nullptr);
+
+    ~topology();
+
+    topology(topology const&) = delete;
+    topology& operator=(topology const&) = delete;
+
+    // Mark this topology as replaced by a newer one
+    void retire();
+    bool retired() const;
+
+    sensors::backend backend() const { return m_backend; }
+    std::string_view sysfs_root() const { return m_sysfs_root; }
+    descriptor_table* descriptors() const { return m_descriptors; }
+
+    chip_record const* chips() const { return m_chips; }
+    std::size_t chip_count() const { return m_chip_count; }
+
+    // Look up the sysfs path of a chip directory, or that of a feature or
+    // subfeature, which is its chip's path followed by its name. Returns
+    // nullptr if nothing was found. The index is built on first use.
+    path_entry const* find(std::string_view path) const;
+
+private:
+    struct counts
+    {
+        std::size_t chips;
+        std::size_t features;
+        std::size_t subfeatures;
+        std::size_t string_bytes;
+    };
+
+    topology(enumeration const& objects, counts n, sensors::backend backend, std::string_view sysfs_root,
+             std::shared_ptr<sensors::config const> config, bool configured, descriptor_table* descriptors);
+    static counts count(enumeration const& objects);
+    bool computed(chip_record const& chip, sensors_feature const& feat) const;
+    char* copy(char const* string);
+    std::string_view copy(std::string const& string);
+    void apply_computes();
+    void build_index() const;
+
+    mutable std::pmr::monotonic_buffer_resource m_arena;
+    sensors::backend const m_backend;
+    std::string const m_sysfs_root;
+    std::shared_ptr<sensors::config const> const m_config;
+    bool const m_configured;
+    descriptor_table* const m_descriptors;
+    chip_record* m_chips = nullptr;
+    feature_record* m_features = nullptr;
+    subfeature_record* m_subfeatures = nullptr;
+    std::size_t m_chip_count = 0;
+    std::size_t m_feature_count = 0;
+    std::size_t m_subfeature_count = 0;
+
+    std::atomic<bool> m_retired {false};
+
+    mutable std::once_flag m_index_built;
+    // Keyed by views of strings in the arena, so that find() needs no copy of
+    // the path it looks up
+    mutable std::optional<std::pmr::unordered_map<std::string_view, path_entry>> m_index;
+};
+
+// A loaded backend and its current topology, which the context takes over when
+// a new handle replaces this one
+class backend_handle
+{
+public:
+    virtual ~backend_handle();
+
+    backend_handle(backend_handle const&) = delete;
+    backend_handle& operator=(backend_handle const&) = delete;
+
+    std::string const& config_path() const
+    {
+        return m_path;
+    }
+
+    sensors::topology const& topology() const
+    {
+        return *m_topology;
+    }
+
+    // Mark the topology as replaced and give it up
+    std::unique_ptr<sensors::topology> retire();
+
+protected:
+    explicit backend_handle(std::string_view config_path);
+
+    std::string m_path;
+    std::unique_ptr<sensors::topology> m_topology;
+};
+
+// RAII class for libsensors resources
+class libsensors_handle : public backend_handle
+{
+public:
+    // Takes over libsensors from the handle of the previous generation, if
+    // given, which keeps it if this throws
+    libsensors_handle(std::string_view config_path, libsensors_handle* previous, descriptor_table& descriptors);
+    ~libsensors_handle();
+
+private:
+    std::FILE* m_config;
+    // Whether this handle is the one that initialised libsensors
+    bool m_owner = true;
+};
+
+// The native backend, which reads the hwmon class in sysfs itself and applies
+// the statements of its configuration file that sensors::config supports
+class hwmon_handle : public backend_handle
+{
+public:
+    hwmon_handle(std::string_view config_path, std::string_view sysfs_root, descriptor_table& descriptors);
+};
+
+// Shared lock on libsensors, which is process-wide and can be used by one
+// context at a time. Held around every call into libsensors, while that context
+// holds it exclusively to initialise or clean up libsensors. Instances may be
+// nested within a thread.
+class libsensors_lock
+{
+public:
+    libsensors_lock();
+    ~libsensors_lock();
+
+    libsensors_lock(libsensors_lock const&) = delete;
+    libsensors_lock& operator=(libsensors_lock const&) = delete;
+};
+
+struct _sensors_access
+{
+    static sysfs_attribute const& attribute(subfeature const& sub)
+    {
+        return sub.m_impl->m_attribute;
+    }
+
+    static context::state& state(context const& ctx)
+    {
+        return *ctx.m_state;
+    }
+};
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_IMPL_H
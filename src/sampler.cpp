@@ -0,0 +1,285 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sensors-c++/sampler.h"
+#include "sensors-c++/error.h"
+#include "impl.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace sensors {
+
+namespace {
+
+init_error system_error(char const* what)
+{
+    return init_error{std::string{what} + " (" + std::strerror(errno) + ")"};
+}
+
+timespec to_timespec(sampler::clock::time_point time)
+{
+    auto const since_epoch = time.time_since_epoch();
+    auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    auto const nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - seconds);
+    return {static_cast<time_t>(seconds.count()), static_cast<long>(nanoseconds.count())};
+}
+
+} // anonymous namespace
+
+sampler::entry::entry(sensors::subfeature const& sub, clock::duration period, std::size_t history_size)
+    : subfeature{sub}
+    , attribute{_sensors_access::attribute(sub)}
+    , period{period}
+    , history{history_size ? std::make_unique<sensors::history>(history_size) : nullptr}
+{
+}
+
+// steady_clock is CLOCK_MONOTONIC on Linux, so its time points can be used as
+// absolute timer deadlines. The timer and m_ready are non-blocking for drain().
+sampler::sampler()
+    : m_timer{::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)}
+    , m_wakeup{::eventfd(0, EFD_CLOEXEC)}
+    , m_ready{::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)}
+    , m_epoll{::epoll_create1(EPOLL_CLOEXEC)}
+{
+    epoll_event ready {EPOLLIN, {}};
+    if (m_timer < 0 || m_wakeup < 0 || m_ready < 0 || m_epoll < 0
+            || ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_ready, &ready)) {
+        auto const error = system_error("Failed to create sampler timer");
+        for (auto fd : {m_timer, m_wakeup, m_ready, m_epoll})
+            if (fd >= 0)
+                ::close(fd);
+        throw error;
+    }
+}
+
+sampler::~sampler()
+{
+    stop();
+    ::close(m_timer);
+    ::close(m_wakeup);
+    ::close(m_ready);
+    ::close(m_epoll);
+}
+
+std::size_t sampler::add(sensors::subfeature const& sub, clock::duration period, std::size_t history_size)
+{
+    if (running())
+        throw std::logic_error{"Cannot add subfeatures to a running sampler"};
+    if (period <= clock::duration::zero())
+        throw std::logic_error{"Sampling period must be positive"};
+    m_entries.emplace_back(sub, period, history_size);
+    return m_entries.size() - 1;
+}
+
+std::size_t sampler::size() const
+{
+    return m_entries.size();
+}
+
+void sampler::start(threading mode)
+{
+    if (running())
+        return;
+    auto const now = clock::now();
+    for (auto& e : m_entries)
+        e.due = now;
+    if (mode == threading::background) {
+        m_thread = std::thread{&sampler::run, this};
+    } else {
+        arm();
+        epoll_event timer {EPOLLIN, {}};
+        ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_timer, &timer);
+    }
+    m_running = true;
+}
+
+void sampler::stop()
+{
+    if (!running())
+        return;
+    if (m_thread.joinable()) {
+        std::uint64_t value = 1;
+        ::write(m_wakeup, &value, sizeof value);
+        m_thread.join();
+        ::read(m_wakeup, &value, sizeof value);
+    } else {
+        ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, m_timer, nullptr);
+    }
+    itimerspec const disarm {};
+    ::timerfd_settime(m_timer, 0, &disarm, nullptr);
+    m_running = false;
+}
+
+bool sampler::running() const
+{
+    return m_running;
+}
+
+int sampler::fd() const
+{
+    return m_epoll;
+}
+
+sampler::sample sampler::load(entry const& e, unsigned& sequence)
+{
+    sample s;
+    unsigned after;
+    do {
+        sequence = e.sequence.load(std::memory_order_acquire);
+        s.value = e.value.load(std::memory_order_relaxed);
+        s.time = clock::time_point{clock::duration{e.time.load(std::memory_order_relaxed)}};
+        s.error = e.error.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = e.sequence.load(std::memory_order_relaxed);
+    } while (sequence & 1 || sequence != after);
+    return s;
+}
+
+sampler::sample sampler::latest(std::size_t index) const
+{
+    unsigned sequence;
+    return load(m_entries[index], sequence);
+}
+
+std::size_t sampler::drain(std::vector<update>& out)
+{
+    out.clear();
+    std::uint64_t count;
+    if (running() && !m_thread.joinable() && ::read(m_timer, &count, sizeof count) > 0) {
+        sweep(clock::now());
+        arm();
+    }
+
+    // Clear the signal before looking, so that a sweep that is still running
+    // signals again
+    ::read(m_ready, &count, sizeof count);
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        auto& e = m_entries[i];
+        if (e.sequence.load(std::memory_order_acquire) == e.drained)
+            continue;
+        unsigned sequence;
+        auto const s = load(e, sequence);
+        if (sequence != e.drained) {
+            out.push_back({i, s.value, s.time, s.error});
+            e.drained = sequence;
+        }
+    }
+    return out.size();
+}
+
+std::size_t sampler::copy_history(std::size_t index, history& out) const
+{
+    auto const& e = m_entries[index];
+    if (!e.history)
+        return 0;
+    std::lock_guard lock {e.history_lock};
+    out.assign(*e.history);
+    return out.size();
+}
+
+sampler::statistics sampler::stats() const
+{
+    return {
+        m_sweeps.load(std::memory_order_relaxed),
+        m_misses.load(std::memory_order_relaxed),
+        clock::duration{m_last_sweep.load(std::memory_order_relaxed)},
+        clock::duration{m_max_sweep.load(std::memory_order_relaxed)}
+    };
+}
+
+void sampler::run()
+{
+    pollfd fds[] = {{m_timer, POLLIN, 0}, {m_wakeup, POLLIN, 0}};
+    while (true) {
+        arm();
+        if (::poll(fds, 2, -1) < 0)
+            continue;
+        if (fds[1].revents)
+            return;
+        if (fds[0].revents) {
+            std::uint64_t expirations;
+            ::read(m_timer, &expirations, sizeof expirations);
+        }
+        sweep(clock::now());
+        std::uint64_t const value = 1;
+        ::write(m_ready, &value, sizeof value);
+    }
+}
+
+// Set the timer to the earliest deadline
+void sampler::arm()
+{
+    if (m_entries.empty())
+        return;
+    auto const next = std::min_element(m_entries.cbegin(), m_entries.cend(), [](auto const& a, auto const& b) {
+        return a.due < b.due;
+    })->due;
+    itimerspec const deadline {{0, 0}, to_timespec(next)};
+    ::timerfd_settime(m_timer, TFD_TIMER_ABSTIME, &deadline, nullptr);
+}
+
+void sampler::sweep(clock::time_point now)
+{
+    for (auto& e : m_entries) {
+        if (e.due > now)
+            continue;
+
+        double value;
+        auto const error = e.attribute.read(value);
+        auto const sequence = e.sequence.load(std::memory_order_relaxed);
+        e.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (!error)
+            e.value.store(value, std::memory_order_relaxed);
+        auto const time = clock::now();
+        e.time.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+        e.error.store(error, std::memory_order_relaxed);
+        e.sequence.store(sequence + 2, std::memory_order_release);
+        if (e.history && !error) {
+            std::lock_guard lock {e.history_lock};
+            e.history->push(time, value);
+        }
+
+        // Stay in phase, skipping any periods that were missed entirely
+        e.due += e.period;
+        if (e.due <= now) {
+            e.due += ((now - e.due) / e.period + 1) * e.period;
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    auto const duration = (clock::now() - now).count();
+    m_sweeps.fetch_add(1, std::memory_order_relaxed);
+    m_last_sweep.store(duration, std::memory_order_relaxed);
+    if (duration > m_max_sweep.load(std::memory_order_relaxed))
+        m_max_sweep.store(duration, std::memory_order_relaxed);
+}
+
+} // sensors
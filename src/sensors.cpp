@@ -20,6 +20,9 @@
 
 #include "sensors-c++/sensors.h"
 #include "sensors-c++/error.h"
+#include "impl.h"
+#include "config.h"
+#include "hwmon.h"
 #include <sensors/sensors.h>
 
 #include <algorithm>
@@ -27,182 +30,579 @@
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
-#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
 
 using namespace sensors;
 namespace fs = std::filesystem;
 
-namespace sensors { namespace {
+namespace sensors {
+
+namespace {
 
-// RAII class for libsensors resources
-class libsensors_handle
+inline std::string& operator+(std::string&& a, std::string_view b)
 {
-public:
-    libsensors_handle(std::string_view config_path = {})
-        : m_path{config_path}, m_config{std::fopen(m_path.c_str(), "r")}
-    {
-        if (!m_path.empty() && !m_config)
-            throw init_error{std::string{"Failed to open config file ("} + std::strerror(errno) + ")"};
-        auto const error = sensors_init(m_config);
-        if (error)
-            throw init_error{error};
+    return a += b;
+}
+
+std::string_view trim_slashes(std::string_view path)
+{
+    while (path.size() > 1 && path.back() == '/')
+        path.remove_suffix(1);
+    return path;
+}
+
+// Look up the chip at path or at one of its parent directories
+chip_record const* find_chip(topology const& topology, std::string_view path)
+{
+    path = trim_slashes(path);
+    while (!path.empty()) {
+        if (auto const entry = topology.find(path))
+            return entry->chip;
+        auto const slash = path.rfind('/');
+        if (slash == std::string_view::npos || slash == 0)
+            break;
+        path = trim_slashes(path.substr(0, slash));
     }
+    return nullptr;
+}
+
+template<typename Record>
+bool native(Record const& record)
+{
+    return record.m_topology.backend() == backend::native;
+}
+
+int write_value(subfeature_record const& sub, double value)
+{
+    auto const& chip = sub.m_feature.m_chip.get();
+    if (native(sub)) {
+        if (auto const error = sub.m_attribute.to_raw(value))
+            return error;
+        return hwmon_write(chip, sub.get(), value);
+    }
+    libsensors_lock const lock;
+    return sensors_set_value(&chip, sub.get().number, value);
+}
 
-    ~libsensors_handle()
+// Writer-preferring read/write lock, so that load_config() cannot be starved by
+// a steady stream of readers
+class rwlock
+{
+public:
+    rwlock()
     {
-        sensors_cleanup();
-        if (m_config)
-            std::fclose(m_config);
+        pthread_rwlockattr_t attributes;
+        pthread_rwlockattr_init(&attributes);
+        pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        pthread_rwlock_init(&m_lock, &attributes);
+        pthread_rwlockattr_destroy(&attributes);
     }
 
-    std::string const& config_path() const
+    ~rwlock()
     {
-        return m_path;
+        pthread_rwlock_destroy(&m_lock);
     }
 
+    rwlock(rwlock const&) = delete;
+    rwlock& operator=(rwlock const&) = delete;
+
+    void lock() { pthread_rwlock_wrlock(&m_lock); }
+    void unlock() { pthread_rwlock_unlock(&m_lock); }
+    void lock_shared() { pthread_rwlock_rdlock(&m_lock); }
+    void unlock_shared() { pthread_rwlock_unlock(&m_lock); }
+
 private:
-    std::string m_path;
-    std::FILE* m_config;
+    pthread_rwlock_t m_lock;
 };
 
-auto& get_handle()
+// The shared locks this thread holds on contexts and how often each is nested;
+// only the outermost instance locks. A fixed array, so that taking a lock never
+// allocates. The libsensors lock, which reads may take, is counted separately
+// so that try_read() and try_write() cannot fail to take it, however many
+// contexts are locked.
+struct held_lock
 {
-    auto static handle = std::make_unique<libsensors_handle>();
-    return handle;
+    rwlock* lock;
+    unsigned count;
+};
+constexpr std::size_t max_held_locks = 15;
+thread_local held_lock held_locks[max_held_locks];
+thread_local std::size_t held_count = 0;
+
+held_lock* find_held(rwlock& lock)
+{
+    auto const end = held_locks + held_count;
+    auto const held = std::find_if(held_locks, end, [&](auto const& held) { return held.lock == &lock; });
+    return held != end ? held : nullptr;
 }
 
-template<typename T>
-struct impl_base : public std::reference_wrapper<T const>
+void lock_shared(rwlock& lock)
 {
-    using std::reference_wrapper<T const>::reference_wrapper;
-    operator T const*() const { return &this->get(); }
+    if (auto const held = find_held(lock)) {
+        ++held->count;
+        return;
+    }
+    if (held_count == max_held_locks)
+        throw std::logic_error{"Too many contexts locked by one thread"};
+    lock.lock_shared();
+    held_locks[held_count++] = {&lock, 1};
+}
+
+void unlock_shared(rwlock& lock)
+{
+    auto const held = find_held(lock);
+    if (--held->count == 0) {
+        lock.unlock_shared();
+        *held = held_locks[--held_count];
+    }
+}
+
+bool holds_shared(rwlock& lock)
+{
+    return find_held(lock);
+}
+
+// libsensors' global state and the context that uses it
+struct libsensors_state
+{
+    rwlock lock;
+    bool in_use = false;
 };
 
-inline std::string& operator+(std::string&& a, std::string_view b)
+libsensors_state& libsensors()
 {
-    return a += b;
+    static libsensors_state state;
+    return state;
+}
+
+// Nesting of libsensors_lock instances in this thread
+thread_local unsigned libsensors_held = 0;
+
+// The files sensors_init(nullptr) loads: the first of sensors3.conf and
+// sensors.conf in /etc, then those in /etc/sensors.d that are not hidden, in
+// alphabetical order. See sensors_init() in lib/init.c of lm-sensors.
+std::vector<fs::path> default_config_files()
+{
+    std::vector<fs::path> files;
+    std::error_code error;
+    for (auto const path : {"/etc/sensors3.conf", "/etc/sensors.conf"}) {
+        if (fs::exists(path, error)) {
+            files.push_back(path);
+            break;
+        }
+    }
+    auto const first = files.size();
+    for (fs::directory_iterator it {"/etc/sensors.d", error}, end; !error && it != end; it.increment(error))
+        if (it->path().filename().string()[0] != '.' && it->is_regular_file(error))
+            files.push_back(it->path());
+    std::sort(files.begin() + first, files.end());
+    return files;
+}
+
+// Parse the configuration libsensors loaded from file, or from its default
+// files if file is null, to find the compute statements it applies. Sets
+// configured if there is a configuration, and returns null if there is none
+// or it could not be parsed.
+std::shared_ptr<config const> parse_libsensors_config(std::FILE* file, bool& configured)
+{
+    configured = file;
+    try {
+        if (file) {
+            std::rewind(file);
+            return std::make_shared<config const>(file);
+        }
+        auto const files = default_config_files();
+        configured = !files.empty();
+        if (!configured)
+            return {};
+        auto parsed = std::make_shared<config>();
+        for (auto const& path : files) {
+            std::unique_ptr<std::FILE, int (*)(std::FILE*)> const default_file {std::fopen(path.c_str(), "r"),
+                                                                                std::fclose};
+            if (!default_file)
+                return {};
+            parsed->append(default_file.get());
+        }
+        return parsed;
+    } catch (init_error const&) {
+        return {};
+    }
 }
 
 } // anonymous namespace
 
-// Implementation helper classes
-template<typename T>
-_sensors_impl<T>::_sensors_impl(impl&& _impl)
-    : m_impl{std::make_shared<impl>(std::move(_impl))}
+libsensors_lock::libsensors_lock()
 {
+    if (libsensors_held++ == 0)
+        libsensors().lock.lock_shared();
 }
 
-template<typename T>
-_sensors_impl<T>::operator const impl*() const
+libsensors_lock::~libsensors_lock()
 {
-    return m_impl.get();
+    if (--libsensors_held == 0)
+        libsensors().lock.unlock_shared();
 }
 
-template<>
-struct _sensors_impl<bus_id>::impl : public impl_base<sensors_bus_id>
+backend_handle::backend_handle(std::string_view config_path)
+    : m_path{config_path}
 {
-    using impl_base::impl_base;
-};
+}
+
+backend_handle::~backend_handle() = default;
 
-template<>
-struct _sensors_impl<chip_name>::impl : public impl_base<sensors_chip_name>
+std::unique_ptr<topology> backend_handle::retire()
 {
-    using impl_base::impl_base;
+    m_topology->retire();
+    return std::move(m_topology);
+}
 
-    impl static find(std::string_view path)
-    {
-        get_handle();
-        int nr = 0;
-        while (auto name = sensors_get_detected_chips(nullptr, &nr)) {
-            if (path.rfind(name->path, 0) == 0)
-                return *name;
+libsensors_handle::libsensors_handle(std::string_view config_path, libsensors_handle* previous,
+                                     descriptor_table& descriptors)
+    : backend_handle{config_path}, m_config{std::fopen(m_path.c_str(), "r")}
+{
+    if (!m_path.empty() && !m_config)
+        throw init_error{std::string{"Failed to open config file ("} + std::strerror(errno) + ")"};
+    auto& state = libsensors();
+    std::lock_guard lock {state.lock};
+    if (state.in_use && !previous) {
+        if (m_config)
+            std::fclose(m_config);
+        throw init_error{"libsensors is in use by another context"};
+    }
+
+    // libsensors holds one configuration at a time, so that of the previous
+    // handle is replaced and loaded again if this fails. The destructor does
+    // not run if this throws, so clean up here and only claim libsensors once
+    // the handle is complete.
+    auto const fail = [&]{
+        if (previous) {
+            if (previous->m_config)
+                std::rewind(previous->m_config);
+            sensors_init(previous->m_config);
         }
-        throw parse_error{"No chip found at " + path};
+        if (m_config)
+            std::fclose(m_config);
+    };
+    if (previous)
+        sensors_cleanup();
+    if (auto const error = sensors_init(m_config)) {
+        fail();
+        throw init_error{error};
     }
-};
+    try {
+        bool configured;
+        auto parsed = parse_libsensors_config(m_config, configured);
+        m_topology = topology::create(libsensors_enumeration{}, backend::libsensors, {}, std::move(parsed),
+                                      configured, &descriptors);
+    } catch (...) {
+        sensors_cleanup();
+        fail();
+        throw;
+    }
+    if (previous)
+        previous->m_owner = false;
+    state.in_use = true;
+}
 
-template<>
-struct _sensors_impl<feature>::impl : public impl_base<sensors_feature>
+libsensors_handle::~libsensors_handle()
 {
-    using impl_base::impl_base;
+    auto& state = libsensors();
+    std::lock_guard lock {state.lock};
+    if (m_owner) {
+        sensors_cleanup();
+        state.in_use = false;
+    }
+    if (m_config)
+        std::fclose(m_config);
+}
 
-    chip_name m_chip;
+hwmon_handle::hwmon_handle(std::string_view config_path, std::string_view sysfs_root,
+                           descriptor_table& descriptors)
+    : backend_handle{config_path}
+{
+    std::shared_ptr<config const> parsed;
+    if (!m_path.empty()) {
+        std::unique_ptr<std::FILE, int (*)(std::FILE*)> file {std::fopen(m_path.c_str(), "r"), std::fclose};
+        if (!file)
+            throw init_error{std::string{"Failed to open config file ("} + std::strerror(errno) + ")"};
+        parsed = std::make_shared<config const>(file.get());
+    }
+    m_topology = hwmon_topology(sysfs_root, std::move(parsed), descriptors);
+}
 
-    impl(chip_name chip, sensors_feature const& feat) : impl_base{feat}, m_chip{std::move(chip)} {}
+// The backend handle of a context and the lock guarding it. The generations a
+// reload replaces are kept until the context is destroyed, since handles do not
+// own the records they refer to; all of them share the attribute file
+// descriptors, which are destroyed last.
+struct context::state
+{
+    rwlock lock;
+    backend type;
+    std::string sysfs_root;
+    descriptor_table descriptors;
+    std::vector<std::unique_ptr<sensors::topology>> retired;
+    std::unique_ptr<backend_handle> handle;
 
-    // E.g. /sys/class/hwmon/hwmon0, temp1
-    impl static find(std::string_view chip_path, std::string_view feature_name)
+    // Build the new generation alongside the current one, which is only
+    // replaced if that succeeds
+    void load(backend next_type, std::string_view next_root, std::string_view config_path)
     {
-        int nr = 0;
-        chip_name chip {chip_path};
-        while (auto feat = sensors_get_features(*chip, &nr)) {
-            if (feature_name.rfind(feat->name, 0) == 0)
-                return {std::move(chip), *feat};
+        std::unique_ptr<backend_handle> next;
+        if (next_type == backend::native) {
+            next = std::make_unique<hwmon_handle>(config_path, next_root, descriptors);
+        } else {
+            auto const previous = handle && type == backend::libsensors
+                ? static_cast<libsensors_handle*>(handle.get()) : nullptr;
+            next = std::make_unique<libsensors_handle>(config_path, previous, descriptors);
+        }
+        if (handle) {
+            retired.reserve(retired.size() + 1);
+            retired.push_back(handle->retire());
         }
-        throw parse_error{"Feature " + feature_name + " not found on chip " + chip.prefix()};
+        handle = std::move(next);
+        type = next_type;
+        sysfs_root = next_root;
+    }
+
+    // The current topology. The caller must hold a read_lock.
+    sensors::topology const& topology() const
+    {
+        return handle->topology();
     }
 };
 
-template<>
-struct _sensors_impl<subfeature>::impl : public impl_base<sensors_subfeature>
+// Handles
+template<typename T>
+bool _sensors_impl<T>::stale() const
 {
-    using impl_base::impl_base;
+    return m_impl->m_topology.retired();
+}
 
-    ::feature m_feature;
+template struct _sensors_impl<bus_id>;
+template struct _sensors_impl<chip_name>;
+template struct _sensors_impl<feature>;
+template struct _sensors_impl<subfeature>;
 
-    impl(::feature feat, sensors_subfeature const& subfeat) : impl_base{subfeat}, m_feature{std::move(feat)} {}
+// Ranges
+template<typename T>
+T object_range<T>::iterator::operator*() const
+{
+    return T{m_first[m_index]};
+}
 
-    impl static find(std::string_view full_path)
-    {
-        fs::path path {full_path};
-        if (!path.has_filename())
-            throw parse_error{"Path does not contain filename: " + full_path};
+template<typename T>
+object_range<T>::operator std::vector<T>() const
+{
+    std::vector<T> objects;
+    objects.reserve(m_size);
+    for (auto record = first(); record != first() + m_size; ++record)
+        objects.push_back(T{*record});
+    return objects;
+}
+
+template class object_range<chip_name>;
+template class object_range<feature>;
+template class object_range<subfeature>;
 
-        int nr = 0;
-        auto const sub_name = path.filename().string();
-        ::feature feat {full_path, sub_name};
-        while (auto sub = sensors_get_all_subfeatures(*feat.chip(), *feat, &nr))
-            if (sub->name == sub_name)
-                return {std::move(feat), *sub};
+// Implementation helper classes
+chip_record const& chip_record::find(context const& ctx, std::string_view path, read_lock const&)
+{
+    if (auto const chip = find_chip(_sensors_access::state(ctx).topology(), path))
+        return *chip;
+    throw parse_error{"No chip found at " + path};
+}
 
+feature_record const& feature_record::find(context const& ctx, std::string_view chip_path,
+                                           std::string_view feature_name, read_lock const& lock)
+{
+    // The name may also be that of a subfeature, e.g. temp1_input
+    auto const& chip = chip_record::find(ctx, chip_path, lock);
+    auto const entry = chip.m_topology.find(std::string{chip.get().path} + '/' + feature_name);
+    if (!entry || !entry->feature)
+        throw parse_error{"Feature " + feature_name + " not found on chip " + chip.get().prefix};
+    return *entry->feature;
+}
+
+subfeature_record const& subfeature_record::find(context const& ctx, std::string_view full_path,
+                                                 read_lock const& lock)
+{
+    fs::path path {full_path};
+    if (!path.has_filename())
+        throw parse_error{"Path does not contain filename: " + full_path};
+
+    auto const sub_name = path.filename().string();
+    auto const& feat = feature_record::find(ctx, full_path, sub_name, lock);
+    auto const entry = feat.m_topology.find(std::string{feat.m_chip.get().path} + '/' + sub_name);
+    if (!entry || !entry->subfeature)
         throw parse_error{"Subfeature not found: " + sub_name};
-    }
-};
+    return *entry->subfeature;
+}
 
 //
 // free functions
 //
+read_lock::read_lock()
+    : read_lock{default_context()}
+{
+}
+
+read_lock::read_lock(context const& ctx)
+    : m_context{ctx}
+{
+    lock_shared(m_context.m_state->lock);
+}
+
+read_lock::~read_lock()
+{
+    unlock_shared(m_context.m_state->lock);
+}
+
+context& default_context()
+{
+    // A sysfs root in the environment selects the native backend, e.g. to run
+    // programs on a synthetic tree
+    static char const* const root = std::getenv("SENSORS_CPP_SYSFS_ROOT");
+    static context instance {root ? backend::native : backend::libsensors, {}, root ? root : "/sys"};
+    return instance;
+}
+
 void load_config(std::string_view path)
 {
-    auto &handle = get_handle();
-    if (path != handle->config_path()) {
-        handle.reset();
-        handle = std::make_unique<libsensors_handle>(path);
-    }
+    default_context().load_config(path);
+}
+
+void select_backend(backend type, std::string_view sysfs_root)
+{
+    default_context().select_backend(type, sysfs_root);
 }
 
 std::vector<chip_name> get_detected_chips()
 {
-    get_handle();
-    int nr = 0;
+    return default_context().get_detected_chips();
+}
+
+std::vector<chip_name> get_detected_chips(chip_pattern const& pattern, bus_type bus)
+{
+    return default_context().get_detected_chips(pattern, bus);
+}
+
+object_range<chip_name> detected_chips()
+{
+    return default_context().detected_chips();
+}
+
+//
+// sensors::context
+//
+context::context(backend type, std::string_view config_path, std::string_view sysfs_root)
+    : m_state{std::make_unique<state>()}
+{
+    m_state->load(type, sysfs_root, config_path);
+}
+
+context::~context() = default;
+
+void context::load_config(std::string_view path)
+{
+    auto& state = *m_state;
+    if (holds_shared(state.lock))
+        throw std::logic_error{"load_config() called while holding a read_lock"};
+    std::lock_guard lock {state.lock};
+    if (!state.handle || path != state.handle->config_path())
+        state.load(state.type, state.sysfs_root, path);
+}
+
+void context::select_backend(backend type, std::string_view sysfs_root)
+{
+    auto& state = *m_state;
+    if (holds_shared(state.lock))
+        throw std::logic_error{"select_backend() called while holding a read_lock"};
+    std::lock_guard lock {state.lock};
+    state.load(type, sysfs_root, {});
+}
+
+std::vector<chip_name> context::get_detected_chips() const
+{
+    return detected_chips();
+}
+
+std::vector<chip_name> context::get_detected_chips(chip_pattern const& pattern, bus_type bus) const
+{
+    read_lock const lock {*this};
+    auto const& topology = m_state->topology();
     std::vector<chip_name> chips;
-    while (auto cn = sensors_get_detected_chips(0, &nr))
-        chips.emplace_back(chip_name{*cn});
+    for (auto chip = topology.chips(); chip != topology.chips() + topology.chip_count(); ++chip)
+        if (pattern.matches(*chip) && (bus == bus_type::any || to_bus_type(chip->get().bus.type) == bus))
+            chips.push_back(chip_name{*chip});
     return chips;
 }
 
+object_range<chip_name> context::detected_chips() const
+{
+    read_lock const lock {*this};
+    auto const& topology = m_state->topology();
+    return {topology.chips(), topology.chip_count()};
+}
+
+//
+// sensors::chip_pattern
+//
+chip_pattern::chip_pattern(std::string_view pattern)
+{
+    sensors_chip_name parsed;
+    if (auto const error = sensors_parse_chip_name(std::string{pattern}.c_str(), &parsed))
+        throw parse_error{error};
+    if (parsed.prefix != SENSORS_CHIP_NAME_PREFIX_ANY)
+        m_prefix = parsed.prefix;
+    m_bus_type = parsed.bus.type;
+    m_bus_nr = parsed.bus.nr;
+    m_address = parsed.addr;
+    sensors_free_chip_name(&parsed);
+}
+
+bool chip_pattern::matches(chip_name const& chip) const
+{
+    return matches(*chip.m_impl);
+}
+
+bool chip_pattern::matches(chip_record const& chip) const
+{
+    sensors_chip_name pattern {};
+    pattern.prefix = m_prefix ? const_cast<char*>(m_prefix->c_str()) : SENSORS_CHIP_NAME_PREFIX_ANY;
+    pattern.bus = {m_bus_type, m_bus_nr};
+    pattern.addr = m_address;
+    return match_chip(pattern, chip.get());
+}
+
 //
 // sensors::bus_id
 //
 std::string_view bus_id::adapter_name() const
 {
+    if (native(*m_impl)) {
+        std::call_once(m_impl->m_adapter_read, [this]{
+            m_impl->m_adapter = hwmon_adapter_name(m_impl->get(), m_impl->m_topology.sysfs_root());
+        });
+        return m_impl->m_adapter;
+    }
+    libsensors_lock const lock;
     auto name = sensors_get_adapter_name(**this);
     return name ? name : "";
 }
 
 bus_type bus_id::type() const
 {
-    switch (m_impl->get().type) {
+    return to_bus_type(m_impl->get().type);
+}
+
+bus_type to_bus_type(short type)
+{
+    switch (type) {
     case SENSORS_BUS_TYPE_I2C: return bus_type::i2c;
     case SENSORS_BUS_TYPE_ISA: return bus_type::isa;
     case SENSORS_BUS_TYPE_PCI: return bus_type::pci;
@@ -225,7 +625,12 @@ short bus_id::nr() const
 // sensors::chip_name
 //
 chip_name::chip_name(std::string_view path)
-    : chip_name{impl::find(path)}
+    : chip_name{default_context(), path}
+{
+}
+
+chip_name::chip_name(context const& ctx, std::string_view path)
+    : chip_name{impl::find(ctx, path, read_lock{ctx})}
 {
 }
 
@@ -236,7 +641,7 @@ int chip_name::address() const
 
 bus_id chip_name::bus() const
 {
-    return {m_impl->get().bus};
+    return {m_impl->m_bus};
 }
 
 std::string_view chip_name::prefix() const
@@ -249,42 +654,47 @@ std::string_view chip_name::path() const
     return m_impl->get().path;
 }
 
-std::string chip_name::name() const
+std::string_view chip_name::name() const
 {
-    auto const size = sensors_snprintf_chip_name(nullptr, 0, **this);
-    if (size < 0)
-        throw io_error{std::strerror(size)};
-    std::string name(size, '\0');
-    auto const written = sensors_snprintf_chip_name(name.data(), size, **this);
-    if (written < 0)
-        throw io_error{std::strerror(written)};
-    return name;
+    if (m_impl->m_name_error)
+        throw io_error{m_impl->m_name_error};
+    return m_impl->m_name;
 }
 
 std::vector<feature> chip_name::features() const
 {
-    int nr = 0;
-    std::vector<feature> features;
-    while (auto feat = sensors_get_features(**this, &nr))
-        features.emplace_back(feature{{*this, *feat}});
-    return features;
+    return feature_range();
+}
+
+object_range<feature> chip_name::feature_range() const
+{
+    return {m_impl->m_features, m_impl->m_feature_count};
 }
 
 //
 // sensors::feature
 //
 feature::feature(std::string_view full_path)
-    : feature{full_path, fs::path{full_path}.filename().string()}
+    : feature{default_context(), full_path}
+{}
+
+feature::feature(context const& ctx, std::string_view full_path)
+    : feature{ctx, full_path, fs::path{full_path}.filename().string()}
 {}
 
 feature::feature(std::string_view chip_path, std::string_view feature_name)
-    : feature{impl::find(chip_path, feature_name)}
+    : feature{default_context(), chip_path, feature_name}
+{
+}
+
+feature::feature(context const& ctx, std::string_view chip_path, std::string_view feature_name)
+    : feature{impl::find(ctx, chip_path, feature_name, read_lock{ctx})}
 {
 }
 
-chip_name const& feature::chip() const
+chip_name feature::chip() const
 {
-    return m_impl->m_chip;
+    return {m_impl->m_chip};
 }
 
 std::string_view feature::name() const
@@ -315,45 +725,44 @@ feature_type feature::type() const
     }
 }
 
-std::string feature::label() const
+std::string_view feature::label() const
 {
-    // The call should always return a valid pointer because we only use valid
-    // sensor pointers, but still check
-    auto const c_ptr = sensors_get_label(*chip(), **this);
-    std::string label {c_ptr ? c_ptr : ""};
-    std::free(c_ptr);
-    return label;
+    return m_impl->m_label;
 }
 
 std::optional<subfeature> feature::subfeature(subfeature_type type) const
 {
-    auto subs = subfeatures();
-    auto const it = std::find_if(subs.cbegin(), subs.cend(), [=](auto const& sf){ return sf.type() == type; });
-    if (it != subs.end())
-        return *it;
+    if (auto const sub = m_impl->m_by_type[static_cast<std::size_t>(type)])
+        return ::subfeature{*sub};
     return {};
 }
 
 std::vector<subfeature> feature::subfeatures() const
 {
-    int nr = 0;
-    std::vector<::subfeature> subfeatures;
-    while (auto sub = sensors_get_all_subfeatures(*chip(), **this, &nr))
-        subfeatures.emplace_back(::subfeature{{*this, *sub}});
-    return subfeatures;
+    return subfeature_range();
+}
+
+object_range<subfeature> feature::subfeature_range() const
+{
+    return {m_impl->m_subfeatures, m_impl->m_subfeature_count};
 }
 
 //
 // sensors::subfeature
 //
 subfeature::subfeature(std::string_view path)
-    : subfeature{impl::find(path)}
+    : subfeature{default_context(), path}
+{
+}
+
+subfeature::subfeature(context const& ctx, std::string_view path)
+    : subfeature{impl::find(ctx, path, read_lock{ctx})}
 {
 }
 
-feature const& subfeature::feature() const
+feature subfeature::feature() const
 {
-    return m_impl->m_feature;
+    return {m_impl->m_feature};
 }
 
 std::string_view subfeature::name() const
@@ -366,9 +775,9 @@ int subfeature::number() const
     return m_impl->get().number;
 }
 
-subfeature_type subfeature::type() const
+subfeature_type to_subfeature_type(sensors_subfeature_type type)
 {
-    switch (m_impl->get().type) {
+    switch (type) {
         default:
             return subfeature_type::unknown;
 
@@ -532,6 +941,11 @@ subfeature_type subfeature::type() const
     }
 }
 
+subfeature_type subfeature::type() const
+{
+    return to_subfeature_type(m_impl->get().type);
+}
+
 bool subfeature::readable() const
 {
     return m_impl->get().flags & SENSORS_MODE_R;
@@ -550,7 +964,7 @@ bool subfeature::compute_mapping() const
 double subfeature::read() const
 {
     double val;
-    auto const error = sensors_get_value(*feature().chip(), number(), &val);
+    auto const error = m_impl->m_attribute.read(val);
     if (error)
         throw io_error(error);
     return val;
@@ -558,9 +972,23 @@ double subfeature::read() const
 
 void subfeature::write(double value) const
 {
-    auto const error = sensors_set_value(*feature().chip(), number(), value);
+    auto const error = write_value(*m_impl, value);
     if (error)
         throw io_error(error);
 }
 
+std::error_code subfeature::try_read(double& value) const noexcept
+{
+    if (auto const error = m_impl->m_attribute.read(value))
+        return {std::abs(error), libsensors_category()};
+    return {};
+}
+
+std::error_code subfeature::try_write(double value) const noexcept
+{
+    if (auto const error = write_value(*m_impl, value))
+        return {std::abs(error), libsensors_category()};
+    return {};
+}
+
 } // sensors
@@ -0,0 +1,289 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sensors-c++/snapshot.h"
+#include "sensors-c++/history.h"
+#include "impl.h"
+#include "uring.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace sensors {
+
+namespace {
+
+// Submission queue size; larger snapshots are read in several batches
+constexpr unsigned max_ring_entries = 256;
+
+} // anonymous namespace
+
+// Threads that read the subfeatures of one bus each, except for the first bus,
+// which the refreshing thread reads. They write to the snapshot's arrays, whose
+// storage stays in place when the snapshot is moved.
+struct snapshot::bus_workers
+{
+    bus_workers(std::vector<std::size_t> order, std::vector<std::size_t> first, snapshot& snap);
+    ~bus_workers();
+
+    void refresh();
+    void read(std::size_t bus);
+    void run(std::size_t bus);
+
+    // Subfeature indices by bus: those of bus b are order[first[b]] up to
+    // order[first[b + 1]]
+    std::vector<std::size_t> const order;
+    std::vector<std::size_t> const first;
+    sysfs_attribute const* const* const attributes;
+    double* const values;
+    clock::time_point* const times;
+    int* const errors;
+
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable done;
+    // Incremented by every refresh, which waits for pending buses
+    std::uint64_t generation = 0;
+    std::size_t pending = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
+
+snapshot::bus_workers::bus_workers(std::vector<std::size_t> order, std::vector<std::size_t> first, snapshot& snap)
+    : order{std::move(order)}
+    , first{std::move(first)}
+    , attributes{snap.m_attributes.data()}
+    , values{snap.m_values.data()}
+    , times{snap.m_times.data()}
+    , errors{snap.m_errors.data()}
+{
+    for (std::size_t bus = 1; bus + 1 < this->first.size(); ++bus)
+        threads.emplace_back(&bus_workers::run, this, bus);
+}
+
+snapshot::bus_workers::~bus_workers()
+{
+    {
+        std::lock_guard const guard {lock};
+        stopping = true;
+    }
+    start.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+void snapshot::bus_workers::refresh()
+{
+    {
+        std::lock_guard const guard {lock};
+        ++generation;
+        pending = threads.size();
+    }
+    start.notify_all();
+    read(0);
+    std::unique_lock guard {lock};
+    done.wait(guard, [this]{ return !pending; });
+}
+
+void snapshot::bus_workers::read(std::size_t bus)
+{
+    for (auto k = first[bus]; k < first[bus + 1]; ++k) {
+        auto const i = order[k];
+        errors[i] = attributes[i]->read(values[i]);
+        times[i] = clock::now();
+    }
+}
+
+void snapshot::bus_workers::run(std::size_t bus)
+{
+    std::uint64_t seen = 0;
+    std::unique_lock guard {lock};
+    while (true) {
+        start.wait(guard, [&]{ return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+        guard.unlock();
+        read(bus);
+        guard.lock();
+        if (!--pending)
+            done.notify_one();
+    }
+}
+
+snapshot::snapshot(read_engine engine)
+    : snapshot{[]{
+        read_lock const lock;
+        std::vector<sensors::subfeature> subfeatures;
+        for (auto const& chip : detected_chips())
+            for (auto const& feat : chip.feature_range())
+                for (auto&& sub : feat.subfeature_range())
+                    if (sub.readable())
+                        subfeatures.push_back(std::move(sub));
+        return subfeatures;
+    }(), engine}
+{
+}
+
+snapshot::snapshot(std::vector<sensors::subfeature> subfeatures, read_engine engine)
+    : m_subfeatures{std::move(subfeatures)}
+    , m_values(m_subfeatures.size())
+    , m_times(m_subfeatures.size())
+    , m_errors(m_subfeatures.size())
+{
+    m_attributes.reserve(m_subfeatures.size());
+    for (auto const& sub : m_subfeatures)
+        m_attributes.push_back(&_sensors_access::attribute(sub));
+
+    if (engine == read_engine::io_uring && !m_subfeatures.empty()) {
+        auto const entries = static_cast<unsigned>(std::min<std::size_t>(m_subfeatures.size(), max_ring_entries));
+        m_ring = std::make_unique<uring>(entries);
+        if (m_ring->valid())
+            m_buffers.resize(m_subfeatures.size() * sysfs_attribute::buffer_size);
+        else
+            m_ring.reset();
+    }
+
+    if (engine == read_engine::per_bus) {
+        std::vector<std::pair<bus_type, short>> buses;
+        buses.reserve(m_subfeatures.size());
+        for (auto const& sub : m_subfeatures) {
+            auto const bus = sub.feature().chip().bus();
+            buses.emplace_back(bus.type(), bus.nr());
+        }
+        std::vector<std::size_t> order(m_subfeatures.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) { return buses[a] < buses[b]; });
+        std::vector<std::size_t> first;
+        for (std::size_t k = 0; k < order.size(); ++k)
+            if (!k || buses[order[k]] != buses[order[k - 1]])
+                first.push_back(k);
+        first.push_back(order.size());
+        if (first.size() > 2)
+            m_workers = std::make_unique<bus_workers>(std::move(order), std::move(first), *this);
+    }
+}
+
+snapshot::snapshot(snapshot&&) noexcept = default;
+snapshot& snapshot::operator=(snapshot&&) noexcept = default;
+snapshot::~snapshot() = default;
+
+read_engine snapshot::engine() const
+{
+    if (m_ring)
+        return read_engine::io_uring;
+    return m_workers ? read_engine::per_bus : read_engine::sync;
+}
+
+std::size_t snapshot::size() const
+{
+    return m_subfeatures.size();
+}
+
+std::vector<subfeature> const& snapshot::subfeatures() const
+{
+    return m_subfeatures;
+}
+
+std::vector<double> const& snapshot::values() const
+{
+    return m_values;
+}
+
+std::vector<snapshot::clock::time_point> const& snapshot::times() const
+{
+    return m_times;
+}
+
+std::vector<int> const& snapshot::errors() const
+{
+    return m_errors;
+}
+
+void snapshot::attach(std::size_t index, history* h)
+{
+    if (m_histories.empty())
+        m_histories.resize(m_subfeatures.size());
+    m_histories.at(index) = h;
+}
+
+void snapshot::refresh()
+{
+    if (m_ring)
+        refresh_ring();
+    else if (m_workers)
+        m_workers->refresh();
+    else
+        refresh_sync(0, m_attributes.size());
+
+    for (std::size_t i = 0; i < m_histories.size(); ++i)
+        if (m_histories[i] && !m_errors[i])
+            m_histories[i]->push(m_times[i], m_values[i]);
+}
+
+void snapshot::refresh_sync(std::size_t first, std::size_t last)
+{
+    for (auto i = first; i < last; ++i) {
+        m_errors[i] = m_attributes[i]->read(m_values[i]);
+        m_times[i] = clock::now();
+    }
+}
+
+void snapshot::refresh_ring()
+{
+    auto const complete = [this](std::uint64_t i, int result) {
+        auto const buffer = &m_buffers[i * sysfs_attribute::buffer_size];
+        m_errors[i] = m_attributes[i]->parse(buffer, result, m_values[i]);
+        m_times[i] = clock::now();
+    };
+
+    // On failure of the ring, redo the current batch with blocking reads and
+    // don't use it again
+    std::size_t batch = 0;
+    auto const fail = [&]{
+        m_ring.reset();
+        refresh_sync(batch, m_attributes.size());
+    };
+
+    for (std::size_t i = 0; i < m_attributes.size(); ++i) {
+        auto const fd = m_attributes[i]->fd();
+        if (fd < 0) {
+            // Delegated to libsensors
+            refresh_sync(i, i + 1);
+            continue;
+        }
+        auto const buffer = &m_buffers[i * sysfs_attribute::buffer_size];
+        if (!m_ring->prepare_read(fd, buffer, sysfs_attribute::buffer_size - 1, i)) {
+            if (m_ring->run(complete))
+                return fail();
+            batch = i;
+            m_ring->prepare_read(fd, buffer, sysfs_attribute::buffer_size - 1, i);
+        }
+    }
+    if (m_ring->run(complete))
+        fail();
+}
+
+} // sensors
@@ -0,0 +1,240 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sysfs.h"
+#include "config.h"
+#include "impl.h"
+#include <sensors/error.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <optional>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sensors {
+
+namespace {
+
+// Variables of compute rules may refer to subfeatures with rules of their own,
+// see DEPTH_MAX in lib/access.c of lm-sensors
+constexpr unsigned max_compute_depth = 8;
+thread_local unsigned compute_depth = 0;
+
+} // anonymous namespace
+
+double sysfs_scaling(sensors_subfeature_type type)
+{
+    switch (type & 0xFF80) {
+    case SENSORS_SUBFEATURE_IN_INPUT:
+    case SENSORS_SUBFEATURE_TEMP_INPUT:
+    case SENSORS_SUBFEATURE_CURR_INPUT:
+    case SENSORS_SUBFEATURE_HUMIDITY_INPUT:
+        return 1000;
+    case SENSORS_SUBFEATURE_FAN_INPUT:
+        return 1;
+    case SENSORS_SUBFEATURE_POWER_AVERAGE:
+    case SENSORS_SUBFEATURE_ENERGY_INPUT:
+        return 1000000;
+    }
+
+    switch (type) {
+    case SENSORS_SUBFEATURE_POWER_AVERAGE_INTERVAL:
+    case SENSORS_SUBFEATURE_VID:
+    case SENSORS_SUBFEATURE_TEMP_OFFSET:
+        return 1000;
+    default:
+        return 1;
+    }
+}
+
+descriptor_table::~descriptor_table()
+{
+    for (auto const& [path, fd] : m_descriptors)
+        ::close(fd);
+    for (auto fd : m_replaced)
+        ::close(fd);
+}
+
+int descriptor_table::open(char const* path)
+{
+    std::lock_guard const lock {m_lock};
+    try {
+        auto const [it, added] = m_descriptors.try_emplace(path, -1);
+        if (!added) {
+            // The device may have gone and another taken its place
+            struct stat opened, current;
+            if (::fstat(it->second, &opened) == 0 && ::stat(path, &current) == 0
+                    && opened.st_dev == current.st_dev && opened.st_ino == current.st_ino)
+                return it->second;
+            m_replaced.reserve(m_replaced.size() + 1);
+        }
+        auto const fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (added)
+                m_descriptors.erase(it);
+            return fd;
+        }
+        if (!added)
+            m_replaced.push_back(it->second);
+        it->second = fd;
+        return fd;
+    } catch (std::bad_alloc const&) {
+        errno = ENOMEM;
+        return -1;
+    }
+}
+
+sysfs_attribute::sysfs_attribute(sensors_chip_name const& chip, sensors_subfeature const& sub, bool libsensors,
+                                 bool computed, descriptor_table* descriptors)
+    : m_chip{chip}, m_sub{sub}, m_libsensors{libsensors}, m_computed{computed}, m_descriptors{descriptors}
+{
+}
+
+sysfs_attribute::~sysfs_attribute()
+{
+    if (m_fd >= 0 && !m_descriptors)
+        ::close(m_fd);
+}
+
+int sysfs_attribute::read(double& value) const
+{
+    if (auto const error = ensure_open())
+        return error;
+    if (m_delegate) {
+        libsensors_lock const lock;
+        double result;
+        auto const error = sensors_get_value(&m_chip, m_sub.number, &result);
+        if (!error)
+            value = result;
+        return error;
+    }
+    if (m_fd < 0)
+        return m_error;
+    return read_raw(value);
+}
+
+int sysfs_attribute::fd() const
+{
+    return ensure_open() ? -1 : m_fd;
+}
+
+int sysfs_attribute::ensure_open() const
+{
+    if (m_opened.load(std::memory_order_acquire))
+        return 0;
+    // open() may call into libsensors. Lock before m_open_lock, as a thread
+    // waiting on it may already hold a libsensors_lock, which a pending
+    // load_config() would keep us from getting while holding m_open_lock.
+    std::optional<libsensors_lock> lock;
+    if (m_libsensors)
+        lock.emplace();
+    std::lock_guard guard {m_open_lock};
+    if (m_opened.load(std::memory_order_relaxed))
+        return 0;
+    return open();
+}
+
+int sysfs_attribute::open() const
+{
+    // Leave unreadable subfeatures to libsensors so errors are reported the same,
+    // or report them as it would, see sensors_get_value()
+    if (!(m_sub.flags & SENSORS_MODE_R)) {
+        m_delegate = m_libsensors;
+        m_error = -SENSORS_ERR_ACCESS_R;
+    // A compute statement of the configuration applies, see the class comment
+    } else if (m_libsensors && m_computed && (m_sub.flags & SENSORS_COMPUTE_MAPPING)) {
+        m_delegate = true;
+    } else {
+        char path[PATH_MAX];
+        std::snprintf(path, sizeof path, "%s/%s", m_chip.path, m_sub.name);
+        m_fd = m_descriptors ? m_descriptors->open(path) : ::open(path, O_RDONLY | O_CLOEXEC);
+        // Out of descriptors or memory for now: fail this read only, and try
+        // again on the next
+        if (m_fd < 0 && (errno == EMFILE || errno == ENFILE || errno == EAGAIN || errno == ENOMEM))
+            return -SENSORS_ERR_KERNEL;
+        if (m_fd < 0) {
+            m_delegate = m_libsensors;
+            m_error = -SENSORS_ERR_KERNEL;
+        }
+    }
+    m_opened.store(true, std::memory_order_release);
+    return 0;
+}
+
+int sysfs_attribute::read_raw(double& value) const
+{
+    char buffer[buffer_size];
+    auto const size = ::pread(m_fd, buffer, sizeof buffer - 1, 0);
+    return parse(buffer, size < 0 ? -errno : size, value);
+}
+
+int sysfs_attribute::parse(char* buffer, long size, double& value) const
+{
+    if (size < 0)
+        return size == -EIO ? -SENSORS_ERR_IO : -SENSORS_ERR_ACCESS_R;
+    buffer[size] = '\0';
+
+    char* end;
+    auto const raw = std::strtod(buffer, &end);
+    if (end == buffer)
+        return -SENSORS_ERR_ACCESS_R;
+    auto result = raw / sysfs_scaling(m_sub.type);
+    if (m_compute) {
+        if (auto const error = evaluate(m_compute->from, m_variables, result))
+            return error;
+    }
+    value = result;
+    return 0;
+}
+
+void sysfs_attribute::set_compute(compute_rule const& rule, sysfs_attribute const* const* variables)
+{
+    m_compute = &rule;
+    m_variables = variables;
+}
+
+int sysfs_attribute::to_raw(double& value) const
+{
+    if (!m_compute)
+        return 0;
+    return evaluate(m_compute->to, m_variables + m_compute->from.variables().size(), value);
+}
+
+int sysfs_attribute::evaluate(expression const& expr, sysfs_attribute const* const* variables, double& value) const
+{
+    return expr.evaluate(value, value, [&](int i, double& result) {
+        if (!variables[i])
+            return -SENSORS_ERR_NO_ENTRY;
+        if (compute_depth >= max_compute_depth)
+            return -SENSORS_ERR_RECURSION;
+        ++compute_depth;
+        auto const error = variables[i]->read(result);
+        --compute_depth;
+        return error;
+    });
+}
+
+} // sensors
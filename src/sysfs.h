@@ -0,0 +1,145 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_SYSFS_H
+#define LIBSENSORS_CPP_SYSFS_H
+
+#include <sensors/sensors.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sensors {
+
+struct compute_rule;
+class expression;
+
+// Scaling factor libsensors divides raw attribute values by, see
+// get_type_scaling() in lib/sysfs.c of lm-sensors
+double sysfs_scaling(sensors_subfeature_type type);
+
+// The attribute files a context has open, which the attributes of all its
+// generations share, so that reloading the configuration does not open each
+// file again. Descriptors are closed when the table is destroyed, after the
+// generations that use them.
+class descriptor_table
+{
+public:
+    descriptor_table() = default;
+    ~descriptor_table();
+
+    descriptor_table(descriptor_table const&) = delete;
+    descriptor_table& operator=(descriptor_table const&) = delete;
+
+    // A read-only descriptor of path, opened by an earlier call if it still
+    // refers to the same file, or else a new one. Returns -1 and sets errno if
+    // the file cannot be opened.
+    int open(char const* path);
+
+private:
+    std::mutex m_lock;
+    std::unordered_map<std::string, int> m_descriptors;
+    // Descriptors of files that were replaced, which older generations may
+    // still read
+    std::vector<int> m_replaced;
+};
+
+// A subfeature's sysfs attribute file, opened on first use and kept open. Reads
+// use pread() at offset 0, which makes sysfs regenerate the value, instead of
+// the open/scan/close sequence sensors_get_value() goes through on every call.
+// Attributes of the libsensors backend leave any reads that cannot be done
+// this way to libsensors; those of the native backend report an error instead.
+// Running out of descriptors or memory only fails the read at hand, so that a
+// later one opens the file after all.
+//
+// libsensors does not expose the compute statements of its configuration, so
+// the libsensors backend parses the same files with sensors::config. A
+// subfeature with SENSORS_COMPUTE_MAPPING set is read through
+// sensors_get_value() if computed is set, i.e. if a compute statement may apply
+// to its feature, see topology::computed(), and directly otherwise.
+class sysfs_attribute
+{
+public:
+    // The file is opened through descriptors if given, which then owns it
+    sysfs_attribute(sensors_chip_name const& chip, sensors_subfeature const& sub, bool libsensors,
+                    bool computed, descriptor_table* descriptors);
+    ~sysfs_attribute();
+
+    sysfs_attribute(sysfs_attribute const&) = delete;
+    sysfs_attribute& operator=(sysfs_attribute const&) = delete;
+
+    // Read the current value into value. Returns 0 or a negative libsensors
+    // error code, like sensors_get_value(), in which case value is unchanged.
+    int read(double& value) const;
+
+    // The open file descriptor, or -1 if the file is not read directly or could
+    // not be opened yet, in which case only read() can be used. Opens the file
+    // if necessary.
+    int fd() const;
+
+    // Convert the result of reading the file, the size returned by read(2) or
+    // a negative errno value, and its contents. Returns 0 or a negative
+    // libsensors error code, in which case value is unchanged.
+    int parse(char* buffer, long size, double& value) const;
+
+    // Size of the buffer to read into for parse()
+    static constexpr unsigned buffer_size = 64;
+
+    // Apply a compute rule of the native backend to values read and written.
+    // variables holds the attributes the rule refers to, those of its from
+    // expression followed by those of its to expression, or nullptr for names
+    // that were not found.
+    void set_compute(compute_rule const& rule, sysfs_attribute const* const* variables);
+
+    // Convert a value to write to the file with the compute rule, if any.
+    // Returns 0 or a negative libsensors error code.
+    int to_raw(double& value) const;
+
+private:
+    // Returns 0, or a negative libsensors error code if the file could not be
+    // opened this time but may be on a later call
+    int ensure_open() const;
+    int open() const;
+    int read_raw(double& value) const;
+    int evaluate(expression const& expr, sysfs_attribute const* const* variables, double& value) const;
+
+    sensors_chip_name const& m_chip;
+    sensors_subfeature const& m_sub;
+    bool const m_libsensors;
+    bool const m_computed;
+    descriptor_table* const m_descriptors;
+    mutable std::mutex m_open_lock;
+    mutable std::atomic<bool> m_opened {false};
+    mutable int m_fd = -1;
+    // Set if values must come from sensors_get_value(), i.e. if a compute rule
+    // applies or the file could not be opened
+    mutable bool m_delegate = false;
+    // Returned by read() if the file cannot be read and is not delegated
+    mutable int m_error = 0;
+    compute_rule const* m_compute = nullptr;
+    sysfs_attribute const* const* m_variables = nullptr;
+};
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_SYSFS_H
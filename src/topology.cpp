@@ -0,0 +1,282 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "impl.h"
+#include "config.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace sensors {
+
+namespace {
+
+template<typename T>
+T* allocate(std::pmr::memory_resource& arena, std::size_t count)
+{
+    return static_cast<T*>(arena.allocate(std::max<std::size_t>(count, 1) * sizeof(T), alignof(T)));
+}
+
+} // anonymous namespace
+
+subfeature_record::impl(feature_record const& feat, sensors_subfeature const& sub, bool computed)
+    : impl_base{sub, feat.m_topology}
+    , m_feature{feat}
+    , m_attribute{feat.m_chip.get(), get(), feat.m_topology.backend() == backend::libsensors, computed,
+                  feat.m_topology.descriptors()}
+{
+}
+
+sensors_chip_name const* libsensors_enumeration::chip(int& nr) const
+{
+    return sensors_get_detected_chips(nullptr, &nr);
+}
+
+sensors_feature const* libsensors_enumeration::feature(sensors_chip_name const& chip, int& nr) const
+{
+    return sensors_get_features(&chip, &nr);
+}
+
+sensors_subfeature const* libsensors_enumeration::subfeature(sensors_chip_name const& chip,
+                                                             sensors_feature const& feat, int& nr) const
+{
+    return sensors_get_all_subfeatures(&chip, &feat, &nr);
+}
+
+std::string libsensors_enumeration::label(sensors_chip_name const& chip, sensors_feature const& feat) const
+{
+    // The call should always return a valid pointer because we only use valid
+    // sensor pointers, but still check
+    auto const c_ptr = sensors_get_label(&chip, &feat);
+    std::string label {c_ptr ? c_ptr : ""};
+    std::free(c_ptr);
+    return label;
+}
+
+std::unique_ptr<topology> topology::create(enumeration const& objects, sensors::backend backend,
+                                           std::string_view sysfs_root, std::shared_ptr<sensors::config const> config,
+                                           bool configured, descriptor_table* descriptors)
+{
+    return std::unique_ptr<topology>{
+        new topology{objects, count(objects), backend, sysfs_root, std::move(config), configured, descriptors}};
+}
+
+// Count everything first so the records and their strings fit in the first block
+// of the arena
+topology::counts topology::count(enumeration const& objects)
+{
+    auto const length = [](char const* string) { return string ? std::strlen(string) + 1 : 0; };
+    counts n {};
+    int chip_nr = 0;
+    while (auto chip = objects.chip(chip_nr)) {
+        ++n.chips;
+        n.string_bytes += length(chip->prefix) + length(chip->path);
+        int feature_nr = 0;
+        while (auto feat = objects.feature(*chip, feature_nr)) {
+            ++n.features;
+            n.string_bytes += length(feat->name);
+            int sub_nr = 0;
+            while (auto sub = objects.subfeature(*chip, *feat, sub_nr)) {
+                ++n.subfeatures;
+                n.string_bytes += length(sub->name);
+            }
+        }
+    }
+    return n;
+}
+
+topology::topology(enumeration const& objects, counts n, sensors::backend backend, std::string_view sysfs_root,
+                   std::shared_ptr<sensors::config const> config, bool configured, descriptor_table* descriptors)
+    : m_arena{n.chips * sizeof(chip_record) + n.features * sizeof(feature_record)
+        + n.subfeatures * sizeof(subfeature_record) + n.string_bytes + 3 * alignof(std::max_align_t)}
+    , m_backend{backend}
+    , m_sysfs_root{sysfs_root}
+    , m_config{std::move(config)}
+    , m_configured{configured || m_config}
+    , m_descriptors{descriptors}
+    , m_chip_count{n.chips}
+    , m_feature_count{n.features}
+    , m_subfeature_count{n.subfeatures}
+{
+    m_chips = allocate<chip_record>(m_arena, m_chip_count);
+    m_features = allocate<feature_record>(m_arena, m_feature_count);
+    m_subfeatures = allocate<subfeature_record>(m_arena, m_subfeature_count);
+
+    auto chip_out = m_chips;
+    auto feature_out = m_features;
+    auto sub_out = m_subfeatures;
+    int chip_nr = 0;
+    while (auto name = objects.chip(chip_nr)) {
+        auto chip_copy = *name;
+        chip_copy.prefix = copy(name->prefix);
+        chip_copy.path = copy(name->path);
+        auto& chip = *new (chip_out++) chip_record{chip_copy, *this};
+        chip.m_features = feature_out;
+        auto const name_size = sensors_snprintf_chip_name(nullptr, 0, &chip.get());
+        if (name_size >= 0) {
+            auto const buffer = allocate<char>(m_arena, name_size + 1);
+            chip.m_name_error = std::min(0, sensors_snprintf_chip_name(buffer, name_size + 1, &chip.get()));
+            chip.m_name = {buffer, static_cast<std::size_t>(name_size)};
+        } else {
+            chip.m_name_error = name_size;
+        }
+        int feature_nr = 0;
+        while (auto feat = objects.feature(*name, feature_nr)) {
+            auto feature_copy = *feat;
+            feature_copy.name = copy(feat->name);
+            auto& feature = *new (feature_out++) feature_record{chip, feature_copy};
+            feature.m_subfeatures = sub_out;
+            feature.m_label = copy(objects.label(chip.get(), feature_copy));
+            auto const feature_computed = computed(chip, feature_copy);
+            int sub_nr = 0;
+            while (auto sub = objects.subfeature(*name, *feat, sub_nr)) {
+                auto sub_copy = *sub;
+                sub_copy.name = copy(sub->name);
+                auto const& subfeature = *new (sub_out++) subfeature_record{feature, sub_copy, feature_computed};
+                auto& by_type = feature.m_by_type[static_cast<std::size_t>(to_subfeature_type(sub->type))];
+                if (!by_type)
+                    by_type = &subfeature;
+            }
+            feature.m_subfeature_count = sub_out - feature.m_subfeatures;
+        }
+        chip.m_feature_count = feature_out - chip.m_features;
+    }
+    if (m_config && m_backend == backend::native)
+        apply_computes();
+}
+
+topology::~topology()
+{
+    std::destroy_n(m_subfeatures, m_subfeature_count);
+    std::destroy_n(m_features, m_feature_count);
+    std::destroy_n(m_chips, m_chip_count);
+}
+
+// Whether libsensors may apply a compute statement to a feature, so that its
+// subfeatures with SENSORS_COMPUTE_MAPPING must be read through it: if one of
+// the configuration names the feature, or if the configuration could not be
+// parsed. Bus statements renumber the I2C buses of chip statements, which
+// sensors::config does not, so then any compute statement may apply to the
+// features of I2C chips.
+bool topology::computed(chip_record const& chip, sensors_feature const& feat) const
+{
+    if (m_backend != backend::libsensors || !m_configured)
+        return false;
+    if (!m_config)
+        return true;
+    if (m_config->has_bus_statements() && chip.get().bus.type == SENSORS_BUS_TYPE_I2C)
+        return true;
+    return m_config->compute(chip.get(), feat.name);
+}
+
+// Bind the compute statements of the configuration of the native backend to
+// the subfeatures they apply to. Their variables name other subfeatures of the
+// same chip, see sensors_lookup_subfeature_name().
+void topology::apply_computes()
+{
+    for (auto feat = m_features; feat != m_features + m_feature_count; ++feat) {
+        auto const& chip = feat->m_chip;
+        auto const rule = m_config->compute(chip.get(), feat->get().name);
+        if (!rule)
+            continue;
+
+        auto const find = [&](std::string const& name) -> sysfs_attribute const* {
+            for (auto f = chip.m_features; f != chip.m_features + chip.m_feature_count; ++f)
+                for (auto sub = f->m_subfeatures; sub != f->m_subfeatures + f->m_subfeature_count; ++sub)
+                    if (name == sub->get().name)
+                        return &sub->m_attribute;
+            return nullptr;
+        };
+        auto const& from = rule->from.variables();
+        auto const& to = rule->to.variables();
+        auto const variables = allocate<sysfs_attribute const*>(m_arena, from.size() + to.size());
+        std::transform(to.begin(), to.end(), std::transform(from.begin(), from.end(), variables, find), find);
+
+        auto const first = m_subfeatures + (feat->m_subfeatures - m_subfeatures);
+        for (auto sub = first; sub != first + feat->m_subfeature_count; ++sub)
+            if (sub->get().flags & SENSORS_COMPUTE_MAPPING)
+                sub->m_attribute.set_compute(*rule, variables);
+    }
+}
+
+char* topology::copy(char const* string)
+{
+    if (!string)
+        return nullptr;
+    auto const size = std::strlen(string) + 1;
+    return static_cast<char*>(std::memcpy(m_arena.allocate(size, 1), string, size));
+}
+
+std::string_view topology::copy(std::string const& string)
+{
+    auto const data = static_cast<char*>(m_arena.allocate(string.size() + 1, 1));
+    return {std::strcpy(data, string.c_str()), string.size()};
+}
+
+void topology::retire()
+{
+    m_retired.store(true, std::memory_order_release);
+}
+
+bool topology::retired() const
+{
+    return m_retired.load(std::memory_order_acquire);
+}
+
+auto topology::find(std::string_view path) const -> path_entry const*
+{
+    std::call_once(m_index_built, &topology::build_index, this);
+    auto const it = m_index->find(path);
+    return it != m_index->end() ? &it->second : nullptr;
+}
+
+void topology::build_index() const
+{
+    // Only called once, so the arena is not used concurrently
+    auto& arena = m_arena;
+    auto& index = m_index.emplace(&arena);
+    index.reserve(m_chip_count + m_feature_count + m_subfeature_count);
+
+    // Keys of features and subfeatures are stored in the arena as well, and
+    // those of chips are their paths, which already are
+    auto const key = [&](chip_record const& chip, char const* name) {
+        std::string_view const dir {chip.get().path}, base {name};
+        auto const out = static_cast<char*>(arena.allocate(dir.size() + 1 + base.size(), 1));
+        dir.copy(out, dir.size());
+        out[dir.size()] = '/';
+        base.copy(out + dir.size() + 1, base.size());
+        return std::string_view{out, dir.size() + 1 + base.size()};
+    };
+    for (auto chip = m_chips; chip != m_chips + m_chip_count; ++chip) {
+        index.try_emplace(chip->get().path, path_entry{chip, nullptr, nullptr});
+        for (auto feat = chip->m_features; feat != chip->m_features + chip->m_feature_count; ++feat) {
+            index.try_emplace(key(*chip, feat->get().name), path_entry{chip, feat, nullptr});
+            for (auto sub = feat->m_subfeatures; sub != feat->m_subfeatures + feat->m_subfeature_count; ++sub) {
+                // Some features have a subfeature of the same name, e.g. cpu0_vid
+                auto& entry = index.try_emplace(key(*chip, sub->get().name), path_entry{chip, feat, nullptr}).first->second;
+                entry.subfeature = sub;
+            }
+        }
+    }
+}
+
+} // sensors
@@ -0,0 +1,200 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "uring.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sensors {
+
+namespace {
+
+int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+bool supports_read(int fd)
+{
+    std::vector<char> storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+    auto const probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    if (io_uring_register(fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+        return false;
+    return probe->ops_len > IORING_OP_READ && probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED;
+}
+
+template<typename T>
+T* at(void* base, unsigned offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+void* map(int fd, std::size_t size, off_t offset)
+{
+    auto const ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+} // anonymous namespace
+
+uring::uring(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof params);
+    m_fd = io_uring_setup(entries, &params);
+    if (m_fd < 0)
+        return;
+
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    auto const single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+        m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    m_sq_ring = map(m_fd, m_sq_ring_size, IORING_OFF_SQ_RING);
+    m_cq_ring = single_mmap ? m_sq_ring : map(m_fd, m_cq_ring_size, IORING_OFF_CQ_RING);
+    m_sqes = static_cast<io_uring_sqe*>(map(m_fd, m_sqes_size, IORING_OFF_SQES));
+    if (!m_sq_ring || !m_cq_ring || !m_sqes || !supports_read(m_fd)) {
+        close();
+        return;
+    }
+
+    m_sq_head = at<unsigned>(m_sq_ring, params.sq_off.head);
+    m_sq_tail = at<unsigned>(m_sq_ring, params.sq_off.tail);
+    m_sq_mask = at<unsigned>(m_sq_ring, params.sq_off.ring_mask);
+    m_sq_entries = at<unsigned>(m_sq_ring, params.sq_off.ring_entries);
+    m_sq_array = at<unsigned>(m_sq_ring, params.sq_off.array);
+    m_cq_head = at<unsigned>(m_cq_ring, params.cq_off.head);
+    m_cq_tail = at<unsigned>(m_cq_ring, params.cq_off.tail);
+    m_cq_mask = at<unsigned>(m_cq_ring, params.cq_off.ring_mask);
+    m_cqes = at<io_uring_cqe>(m_cq_ring, params.cq_off.cqes);
+}
+
+uring::~uring()
+{
+    close();
+}
+
+bool uring::valid() const
+{
+    return m_fd >= 0;
+}
+
+// A cleared entry at the tail of the submission queue, which is added to it
+// right away, or nullptr if the queue is full
+io_uring_sqe* uring::next_sqe()
+{
+    // This is the only producer, so the tail can be read without ordering
+    auto const tail = *m_sq_tail;
+    if (tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= *m_sq_entries)
+        return nullptr;
+
+    auto const index = tail & *m_sq_mask;
+    auto& sqe = m_sqes[index];
+    std::memset(&sqe, 0, sizeof sqe);
+    m_sq_array[index] = index;
+    return &sqe;
+}
+
+bool uring::prepare_read(int fd, void* buffer, unsigned size, std::uint64_t user_data)
+{
+    auto const sqe = next_sqe();
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<std::uintptr_t>(buffer);
+    sqe->len = size;
+    sqe->off = 0;
+    sqe->user_data = user_data;
+    __atomic_store_n(m_sq_tail, *m_sq_tail + 1, __ATOMIC_RELEASE);
+    ++m_queued;
+    return true;
+}
+
+void uring::close()
+{
+    if (m_sqes)
+        ::munmap(m_sqes, m_sqes_size);
+    if (m_cq_ring && m_cq_ring != m_sq_ring)
+        ::munmap(m_cq_ring, m_cq_ring_size);
+    if (m_sq_ring)
+        ::munmap(m_sq_ring, m_sq_ring_size);
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_sqes = nullptr;
+    m_sq_ring = m_cq_ring = nullptr;
+    m_fd = -1;
+}
+
+int uring::submit()
+{
+    while (m_queued) {
+        auto const submitted = io_uring_enter(m_fd, m_queued, 0, 0);
+        if (submitted < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        m_queued -= submitted;
+    }
+    return 0;
+}
+
+int uring::wait()
+{
+    if (io_uring_enter(m_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+        return -errno;
+    return 0;
+}
+
+void uring::discard()
+{
+    // Without SQPOLL the kernel only takes entries from the queue in
+    // io_uring_enter calls that submit, so the unsubmitted ones are still ours
+    __atomic_store_n(m_sq_tail, *m_sq_tail - m_queued, __ATOMIC_RELEASE);
+    m_queued = 0;
+}
+
+int uring::register_eventfd(int fd)
+{
+    if (io_uring_register(m_fd, IORING_REGISTER_EVENTFD, &fd, 1) < 0)
+        return -errno;
+    return 0;
+}
+
+} // sensors
@@ -0,0 +1,151 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_URING_H
+#define LIBSENSORS_CPP_URING_H
+
+#include <linux/io_uring.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+namespace sensors {
+
+// Minimal io_uring instance for batches of positional reads, using the raw
+// system calls so that no liburing dependency is needed
+class uring
+{
+public:
+    // Set up a ring with room for the given number of submissions. Check
+    // valid() to see if this succeeded; it fails if the kernel does not support
+    // io_uring or IORING_OP_READ, or if it is blocked by e.g. seccomp.
+    explicit uring(unsigned entries);
+    ~uring();
+
+    uring(uring const&) = delete;
+    uring& operator=(uring const&) = delete;
+
+    bool valid() const;
+
+    // Queue a read at offset 0 of fd. Returns false if the submission queue is
+    // full, in which case run() or submit() must be called first.
+    bool prepare_read(int fd, void* buffer, unsigned size, std::uint64_t user_data);
+
+    // Submit all queued reads and wait for their completion, calling
+    // complete(user_data, result) for each. The result is the number of bytes
+    // read or a negative errno value. Returns 0 or a negative errno value if
+    // io_uring_enter failed, in which case reads may not have completed.
+    template<typename F>
+    int run(F&& complete);
+
+    // For reads that complete on their own time: submit() passes queued
+    // operations to the kernel without waiting, wait() waits until at least one
+    // has completed and reap() calls complete(user_data, result) for those that
+    // have, returning their number. Only one thread may queue and submit at a
+    // time, and only one may wait and reap, which may be another. Both return 0
+    // or a negative errno value. submit() does not retry if the kernel lacks
+    // the resources for more operations, which it reports with -EAGAIN; the
+    // operations it did not pass on stay queued.
+    int submit();
+    int wait();
+    template<typename F>
+    unsigned reap(F&& complete);
+
+    // Take back the operations that submit() failed to pass to the kernel, so
+    // that they are never carried out
+    void discard();
+
+    // Have the kernel signal an eventfd for every completion, so that a thread
+    // can wait for completions on it instead of in wait(). Returns 0 or a
+    // negative errno value.
+    int register_eventfd(int fd);
+
+    // Release the ring; valid() returns false afterwards
+    void close();
+
+private:
+    io_uring_sqe* next_sqe();
+
+    int m_fd = -1;
+    unsigned m_queued = 0;
+    void* m_sq_ring = nullptr;
+    void* m_cq_ring = nullptr;
+    std::size_t m_sq_ring_size = 0;
+    std::size_t m_cq_ring_size = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    std::size_t m_sqes_size = 0;
+
+    unsigned* m_sq_head;
+    unsigned* m_sq_tail;
+    unsigned* m_sq_mask;
+    unsigned* m_sq_entries;
+    unsigned* m_sq_array;
+    unsigned* m_cq_head;
+    unsigned* m_cq_tail;
+    unsigned* m_cq_mask;
+    io_uring_cqe* m_cqes;
+};
+
+template<typename F>
+int uring::run(F&& complete)
+{
+    auto pending = m_queued;
+    while (pending) {
+        // Without the resources for the rest, reap the reads in flight first
+        if (m_queued) {
+            auto const error = submit();
+            if (error && (error != -EAGAIN || m_queued == pending))
+                return error;
+        }
+
+        auto head = *m_cq_head;
+        auto const tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (auto const error = wait())
+                return error;
+            continue;
+        }
+        for (; head != tail && pending; ++head, --pending) {
+            auto const& cqe = m_cqes[head & *m_cq_mask];
+            complete(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+template<typename F>
+unsigned uring::reap(F&& complete)
+{
+    auto head = *m_cq_head;
+    auto const tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+    for (; head != tail; ++head, ++count) {
+        auto const& cqe = m_cqes[head & *m_cq_mask];
+        complete(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+} // sensors
+
+#endif // LIBSENSORS_CPP_URING_H
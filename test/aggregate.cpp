@@ -0,0 +1,97 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "sensors-c++/aggregate.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace sensors;
+
+namespace {
+
+bool close(double a, double b)
+{
+    return std::abs(a - b) <= 1e-9 * std::max(1.0, std::abs(b));
+}
+
+// Two passes, for reference
+window_statistics reference(std::vector<double> const& values)
+{
+    window_statistics r {values.size(), values[0], values[0], 0, 0};
+    for (auto v : values) {
+        r.min = std::min(r.min, v);
+        r.max = std::max(r.max, v);
+        r.mean += v;
+    }
+    r.mean /= values.size();
+    for (auto v : values)
+        r.stddev += (v - r.mean) * (v - r.mean);
+    r.stddev = std::sqrt(r.stddev / values.size());
+    return r;
+}
+
+} // anonymous namespace
+
+// Compares every instruction set's kernel to a two-pass computation, for all
+// lengths around the vector widths and for values far from zero
+int main()
+{
+    std::cout << "Native instruction set: " << static_cast<int>(native_instruction_set()) << '\n';
+    std::mt19937 random {42};
+    std::normal_distribution<double> noise {0, 2};
+    for (double offset : {0.0, 45.0, -1e3, 1e6}) {
+        for (std::size_t count = 1; count < 70; ++count) {
+            std::vector<double> values(count);
+            for (auto& v : values)
+                v = offset + noise(random);
+            auto const expected = reference(values);
+            for (auto isa : {instruction_set::scalar, instruction_set::sse2, instruction_set::avx2}) {
+                auto const actual = aggregate(values.data(), count, isa);
+                auto const what = "instruction set " + std::to_string(static_cast<int>(isa)) + ", offset "
+                    + std::to_string(offset) + ", count " + std::to_string(count);
+                check(actual.count == count && actual.min == expected.min && actual.max == expected.max
+                      && close(actual.mean, expected.mean) && std::abs(actual.stddev - expected.stddev) < 1e-6, what);
+            }
+        }
+    }
+
+    auto const empty = aggregate(nullptr, 0);
+    check(empty.count == 0 && std::isnan(empty.mean), "no values");
+
+    // A window that wraps around the end of a history
+    history h {50};
+    std::vector<double> pushed;
+    for (int i = 0; i < 80; ++i) {
+        pushed.push_back(40 + noise(random));
+        h.push(history::clock::time_point{std::chrono::seconds{i}}, pushed.back());
+    }
+    auto const w = h.range(history::clock::time_point{std::chrono::seconds{45}},
+                           history::clock::time_point{std::chrono::seconds{75}});
+    check(w.second.size > 0, "wrapped window");
+    auto const expected = reference({pushed.begin() + 45, pushed.begin() + 75});
+    auto const actual = aggregate(w);
+    check(actual.count == 30 && actual.min == expected.min && actual.max == expected.max
+          && close(actual.mean, expected.mean) && std::abs(actual.stddev - expected.stddev) < 1e-9, "history window");
+    return failures ? 1 : 0;
+}
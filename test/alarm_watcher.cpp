@@ -0,0 +1,121 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/alarm_watcher.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace sensors;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct recorder
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<alarm_watcher::event> events;
+
+    void operator()(alarm_watcher::event const& e)
+    {
+        std::lock_guard const guard {lock};
+        events.push_back(e);
+        changed.notify_all();
+    }
+
+    // Wait until count events have been recorded, or for a second
+    bool wait(std::size_t count)
+    {
+        std::unique_lock guard {lock};
+        return changed.wait_for(guard, 1s, [&]{ return events.size() >= count; });
+    }
+
+    std::vector<alarm_watcher::event> recorded()
+    {
+        std::lock_guard const guard {lock};
+        return events;
+    }
+};
+
+} // anonymous namespace
+
+// Checks that changes of alarm files are reported, by polling as the files of a
+// fake tree do not support POLLPRI
+int main()
+{
+    check(is_alarm(subfeature_type::crit_alarm) && is_alarm(subfeature_type::fault), "alarm types");
+    check(!is_alarm(subfeature_type::input) && !is_alarm(subfeature_type::crit), "other types");
+
+    fake_hwmon::layout l;
+    l.chips = 2;
+    l.features = 5;
+    l.subfeatures = 17;
+    fake_hwmon const tree {l};
+    context const ctx {backend::native, {}, tree.root()};
+
+    recorder r;
+    alarm_watcher w {5ms};
+    auto const count = w.add_alarms(ctx, std::ref(r));
+    // Per chip 5 of temp1, 3 of in0, 4 of fan1, 3 of power1 and 2 of curr1
+    check(count == 34 && w.size() == 34, "alarms added");
+    std::size_t in0_alarm = w.size(), fan1_fault = w.size();
+    for (std::size_t i = 0; i < w.size(); ++i) {
+        auto const sub = w.subfeature(i);
+        if (sub.feature().chip().path() == tree.chip_path(1) && sub.name() == "in0_alarm")
+            in0_alarm = i;
+        if (sub.feature().chip().path() == tree.chip_path(0) && sub.name() == "fan1_fault")
+            fan1_fault = i;
+    }
+    check(in0_alarm < w.size() && fan1_fault < w.size(), "subfeatures");
+    check(!w.notifies(0), "regular files are polled");
+
+    w.start();
+    check(w.value(in0_alarm) == 1200 + 1 + 1, "initial value");
+    std::this_thread::sleep_for(20ms);
+    check(r.recorded().empty(), "no changes");
+
+    std::ofstream{tree.chip_path(1) + "/in0_alarm"} << 0;
+    check(r.wait(1), "alarm cleared");
+    auto const cleared = r.recorded().at(0);
+    check(cleared.index == in0_alarm && cleared.value == 0 && !cleared.error, "cleared event");
+    std::ofstream{tree.chip_path(1) + "/in0_alarm"} << 1;
+    std::ofstream{tree.chip_path(0) + "/fan1_fault"} << 1;
+    check(r.wait(3) && w.value(in0_alarm) == 1 && w.value(fan1_fault) == 1, "alarms raised");
+    std::this_thread::sleep_for(20ms);
+    check(r.recorded().size() == 3, "changes reported once");
+
+    bool threw = false;
+    try {
+        w.add(w.subfeature(0), {});
+    } catch (std::logic_error const&) {
+        threw = true;
+    }
+    check(threw, "add while running");
+    w.stop();
+    check(!w.running(), "stopped");
+    return failures ? 1 : 0;
+}
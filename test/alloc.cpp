@@ -0,0 +1,136 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "alloc_count.h"
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/sensors.h"
+#include "sensors-c++/error.h"
+#include "sensors-c++/sampler.h"
+#include "sensors-c++/snapshot.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sensors;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr unsigned iterations = 1000;
+
+// Run op once to warm up, then check that repeating it allocates nothing
+template<typename Op>
+void check_steady(char const* what, Op const& op)
+{
+    op();
+    auto const before = allocation_count();
+    for (unsigned i = 0; i < iterations; ++i)
+        op();
+    auto const allocations = allocation_count() - before;
+    if (allocations) {
+        std::cout << "FAIL: " << what << " made " << allocations << " allocations in " << iterations << " iterations\n";
+        ++failures;
+    }
+}
+
+void check_context(context const& ctx, std::string const& name)
+{
+    // Failed reads throw, which allocates, so leave out what cannot be read
+    std::vector<subfeature> readable;
+    double value;
+    for (auto const& chip : ctx.get_detected_chips())
+        for (auto const& feat : chip.features())
+            for (auto const& sub : feat.subfeatures())
+                if (!sub.try_read(value))
+                    readable.push_back(sub);
+    std::cout << name << ": " << readable.size() << " readable subfeatures\n";
+    if (readable.empty())
+        return;
+
+    check_steady((name + " subfeature::read()").c_str(), [&]{
+        for (auto const& sub : readable)
+            sub.read();
+    });
+    check_steady((name + " subfeature::try_read()").c_str(), [&]{
+        for (auto const& sub : readable)
+            sub.try_read(value);
+    });
+    // Exporters label every sample
+    check_steady((name + " feature::label() and chip_name::name()").c_str(), [&]{
+        for (auto const& sub : readable) {
+            auto const feat = sub.feature();
+            feat.label();
+            feat.chip().name();
+        }
+    });
+
+    for (auto engine : {read_engine::sync, read_engine::io_uring}) {
+        snapshot snap {readable, engine};
+        auto const what = name + " snapshot::refresh() " + (snap.engine() == read_engine::sync ? "sync" : "io_uring");
+        check_steady(what.c_str(), [&]{ snap.refresh(); });
+    }
+
+    // The sampling thread counts as well: nothing in the process may allocate
+    // while it sweeps and latest() is polled
+    sampler s;
+    for (auto const& sub : readable)
+        s.add(sub, std::chrono::milliseconds{1});
+    s.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    check_steady((name + " sampler").c_str(), [&]{
+        for (std::size_t i = 0; i < s.size(); ++i)
+            s.latest(i);
+        std::this_thread::sleep_for(std::chrono::microseconds{50});
+    });
+    s.stop();
+}
+
+} // anonymous namespace
+
+// Checks that once every subfeature has been read, further reads, labels, chip
+// names, snapshot refreshes and sampler sweeps make no heap allocations, on a
+// synthetic tree with and without compute rules, and on the system's sensors if
+// any
+int main()
+{
+    fake_hwmon::layout l;
+    l.chips = 4;
+    fake_hwmon const tree {l};
+    auto const config = fs::path{tree.root()} / "alloc.conf";
+    std::ofstream{config} << "chip \"*-*\"\n"
+                             "    compute temp1 @+temp2_input, @-temp2_input\n"
+                             "    compute in0 @*2, @/2\n";
+
+    check_context(context{backend::native, {}, tree.root()}, "native");
+    check_context(context{backend::native, config.string(), tree.root()}, "native with compute rules");
+    try {
+        check_context(default_context(), "default");
+    } catch (init_error const& e) {
+        std::cout << "Default context unavailable: " << e.what() << '\n';
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "alloc_count.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+namespace {
+
+std::atomic<std::uint64_t> allocations {0};
+
+void count()
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // anonymous namespace
+
+std::uint64_t allocation_count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+// glibc's implementations, which it exports for this purpose
+extern "C" {
+
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* pointer, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(std::size_t size)
+{
+    count();
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t number, std::size_t size)
+{
+    count();
+    return __libc_calloc(number, size);
+}
+
+void* realloc(void* pointer, std::size_t size)
+{
+    count();
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size)
+{
+    count();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    count();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** result, std::size_t alignment, std::size_t size)
+{
+    if (alignment % sizeof(void*) || alignment & (alignment - 1))
+        return EINVAL;
+    count();
+    auto const pointer = __libc_memalign(alignment, size);
+    if (!pointer)
+        return ENOMEM;
+    *result = pointer;
+    return 0;
+}
+
+void free(void* pointer)
+{
+    __libc_free(pointer);
+}
+
+} // extern "C"
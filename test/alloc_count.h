@@ -0,0 +1,32 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_TEST_ALLOC_COUNT_H
+#define LIBSENSORS_CPP_TEST_ALLOC_COUNT_H
+
+#include <cstdint>
+
+// Linking this in replaces malloc and its relatives, which operator new also
+// uses, with versions that count every allocation made in the process
+
+// Number of allocations so far
+std::uint64_t allocation_count();
+
+#endif // LIBSENSORS_CPP_TEST_ALLOC_COUNT_H
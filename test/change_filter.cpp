@@ -0,0 +1,138 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "alloc_count.h"
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/change_filter.h"
+#include "sensors-c++/snapshot.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using namespace sensors;
+using namespace std::chrono_literals;
+
+namespace {
+
+change_filter::clock::time_point at(long seconds)
+{
+    return change_filter::clock::time_point{std::chrono::seconds{seconds}};
+}
+
+std::vector<std::size_t> changes(change_filter const& filter)
+{
+    std::vector<std::size_t> indices;
+    filter.for_each([&](std::size_t i) { indices.push_back(i); });
+    return indices;
+}
+
+} // anonymous namespace
+
+// Checks deadbands, error changes and heartbeats over a mask spanning several
+// words, and filtering a snapshot of a fake tree without allocating
+int main()
+{
+    std::size_t const size = 130;
+    change_filter filter {size};
+    std::vector<double> values(size, 10);
+    std::vector<int> errors(size);
+
+    check(filter.update(values.data(), errors.data(), at(0)) == size, "first update");
+    check(filter.mask_words() == 3 && filter.mask()[2] == 3, "bits past size clear");
+    check(filter.update(values.data(), errors.data(), at(1)) == 0 && filter.count() == 0, "unchanged");
+
+    values[1] = 10.5;
+    values[64] = 9;
+    values[129] = 10 + 1e-12;
+    check(filter.update(values.data(), nullptr, at(2)) == 3, "exact changes");
+    check(changes(filter) == std::vector<std::size_t>{1, 64, 129}, "changed indices");
+    check(filter.changed(64) && !filter.changed(63), "changed()");
+
+    filter.set_deadband(1);
+    filter.set_deadband(2, 0, 0.1);
+    values[1] = 11.5;
+    values[2] = 10.9;
+    values[3] = 11.1;
+    check(filter.update(values.data(), errors.data(), at(3)) == 1 && filter.changed(3), "deadbands");
+    // Drift is measured from the value last passed on
+    values[1] = 11.6;
+    values[2] = 11.05;
+    check(filter.update(values.data(), errors.data(), at(4)) == 2 && filter.changed(1) && filter.changed(2), "drift");
+
+    errors[5] = -4;
+    values[5] = 100;
+    check(filter.update(values.data(), errors.data(), at(5)) == 1 && filter.changed(5), "error");
+    check(filter.update(values.data(), errors.data(), at(6)) == 0, "same error");
+    errors[5] = 0;
+    values[5] = 10;
+    check(filter.update(values.data(), errors.data(), at(7)) == 1 && filter.changed(5), "recovered");
+
+    filter.set_heartbeat(10s);
+    values[6] = 12;
+    check(filter.update(values.data(), errors.data(), at(9)) == 1, "before heartbeat");
+    // All but the seven entries passed on since time 0
+    check(filter.update(values.data(), errors.data(), at(10)) == size - 7, "heartbeat");
+    check(filter.update(values.data(), errors.data(), at(11)) == 0, "after heartbeat");
+
+    filter.reset();
+    check(filter.update(values.data(), errors.data(), at(12)) == size, "reset");
+
+    bool threw = false;
+    try {
+        filter.set_deadband(-1);
+    } catch (std::invalid_argument const&) {
+        threw = true;
+    }
+    check(threw, "negative deadband");
+
+    // Snapshot of a fake tree, of which one input is changed
+    fake_hwmon::layout l;
+    l.chips = 4;
+    fake_hwmon const tree {l};
+    context const ctx {backend::native, {}, tree.root()};
+    std::vector<subfeature> inputs;
+    for (auto const& chip : ctx.get_detected_chips())
+        for (auto const& feat : chip.features())
+            inputs.push_back(*feat.subfeature(subfeature_type::input));
+    snapshot snap {inputs};
+    change_filter sensors {snap.size()};
+    snap.refresh();
+    check(sensors.update(snap) == snap.size(), "first snapshot");
+    auto const before = allocation_count();
+    snap.refresh();
+    check(sensors.update(snap) == 0, "unchanged snapshot");
+    check(allocation_count() == before, "no allocations");
+
+    std::ofstream{tree.chip_path(2) + "/temp1_input"} << 99000;
+    snap.refresh();
+    check(sensors.update(snap) == 1 && inputs[changes(sensors)[0]].read() == 99, "changed input");
+
+    threw = false;
+    try {
+        filter.update(snap);
+    } catch (std::invalid_argument const&) {
+        threw = true;
+    }
+    check(threw, "size mismatch");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_TEST_CHECK_H
+#define LIBSENSORS_CPP_TEST_CHECK_H
+
+#include <iostream>
+#include <string_view>
+
+// Number of failed checks so far; tests return failures ? 1 : 0 from main()
+inline int failures = 0;
+
+// Report and count a failed check, then carry on with the test
+inline void check(bool condition, std::string_view what)
+{
+    if (!condition) {
+        std::cout << "FAIL: " << what << '\n';
+        ++failures;
+    }
+}
+
+#endif // LIBSENSORS_CPP_TEST_CHECK_H
@@ -0,0 +1,167 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "config.h"
+#include "sensors-c++/error.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace sensors;
+
+namespace {
+
+using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE*)>;
+
+file_ptr open(std::string const& text)
+{
+    return {fmemopen(const_cast<char*>(text.data()), text.size(), "r"), std::fclose};
+}
+
+std::unique_ptr<config const> parse(std::string const& text)
+{
+    return std::make_unique<config const>(open(text).get());
+}
+
+// The message of the init_error parsing text throws, if any
+std::optional<std::string> failure(std::string const& text)
+{
+    try {
+        parse(text);
+        return std::nullopt;
+    } catch (init_error const& e) {
+        return e.what();
+    }
+}
+
+bool fails_at(std::string const& text, unsigned line)
+{
+    auto const message = failure(text);
+    return message && message->find("line " + std::to_string(line) + ":") != std::string::npos;
+}
+
+// Evaluate the from expression of the compute statement of feature x at value
+// at, with variables that have the values given in the order they appear
+int evaluate(std::string const& expr, double at, double& result, std::vector<double> const& variables = {})
+{
+    sensors_chip_name chip {};
+    chip.prefix = const_cast<char*>("fake");
+    auto const parsed = parse("chip \"fake-*\"\n    compute x " + expr + ", @\n");
+    auto const rule = parsed->compute(chip, "x");
+    if (!rule)
+        return 1;
+    return rule->from.evaluate(at, result, [&](int i, double& value) {
+        value = variables.at(i);
+        return 0;
+    });
+}
+
+double evaluate(std::string const& expr, double at = 0, std::vector<double> const& variables = {})
+{
+    double result = -1;
+    return evaluate(expr, at, result, variables) ? -1 : result;
+}
+
+} // anonymous namespace
+
+// Checks the configuration parser the native backend uses, and the libsensors
+// backend to find compute statements, directly: the values of compute
+// expressions, which statement wins across chip statements and files, and
+// the errors for malformed input
+int main()
+{
+    // Expressions
+    check(evaluate("1 + 2 * 3") == 7, "precedence of * over +");
+    check(evaluate("(1 + 2) * 3") == 9, "parentheses");
+    check(evaluate("8 / 2 / 2") == 2 && evaluate("8 - 2 - 2") == 4, "left associativity");
+    check(evaluate("@ * 2 + 1", 20) == 41, "@ is the value");
+    check(evaluate("-@ - -1", 3) == -2, "negation");
+    check(evaluate("^0") == 1 && evaluate("`1") == 0 && evaluate("`^2.5") == 2.5, "exp and log");
+    check(evaluate("@ / (in0_input - in1_input)", 12, {5, 2}) == 4, "variables");
+    check(evaluate(".5 * 4") == 2, "number starting with a point");
+    double result = 42;
+    check(evaluate("@ / 0", 1, result) == -SENSORS_ERR_DIV_ZERO, "division by zero");
+    check(evaluate("`-1", 1, result) == -SENSORS_ERR_DIV_ZERO, "log of a negative number");
+
+    sensors_chip_name chip {};
+    chip.prefix = const_cast<char*>("fake");
+    auto const variables = parse("chip \"fake-*\"\n    compute temp1 (@ - temp1_offset) * 2, @ / 2 + temp1_offset\n");
+    auto const rule = variables->compute(chip, "temp1");
+    check(rule && rule->from.variables() == std::vector<std::string>{"temp1_offset"}
+              && rule->to.variables() == std::vector<std::string>{"temp1_offset"}, "variable names");
+
+    // The last matching chip statement that has a statement for a feature wins,
+    // across files as well
+    std::string const first =
+        "# Comment\n"
+        "chip \"fake-*\"\n"
+        "    label temp1 \"First\"\n"
+        "    label in0 \"Only first\"\n"
+        "    ignore fan1\n"
+        "    compute in0 @ * 2, @ / 2\n"
+        "chip \"fake-*\" \"other-*\"\n"
+        "    label temp1 \"Second\"  # trailing comment\n"
+        "    label temp1 \"Second again\"\n"
+        "    set in0_min 1.5\n"
+        "chip \"other-*\"\n"
+        "    label temp1 \"Other\"\n"
+        "    compute in0 @ * 3, @ / 3\n";
+    auto const statements = parse(first);
+    check(std::strcmp(statements->label(chip, "temp1"), "Second") == 0, "last chip statement, first label in it");
+    check(std::strcmp(statements->label(chip, "in0"), "Only first") == 0, "earlier chip statement");
+    check(!statements->label(chip, "fan1"), "no label");
+    check(statements->ignored(chip, "fan1") && !statements->ignored(chip, "temp1"), "ignore");
+    check(statements->compute(chip, "in0")
+              && statements->compute(chip, "in0")->from.evaluate(1, result, [](int, double&) { return 0; }) == 0
+              && result == 2, "compute of the matching chip statement");
+    check(!statements->compute(chip, "temp1"), "no compute");
+
+    config appended;
+    appended.append(open(first).get());
+    appended.append(open("chip \"fake-*\"\n    label in0 \"Appended\"\n").get());
+    check(std::strcmp(appended.label(chip, "in0"), "Appended") == 0
+              && std::strcmp(appended.label(chip, "temp1"), "Second") == 0, "appended file");
+    check(!appended.has_bus_statements() && parse("bus \"i2c-1\" \"SMBus I801 adapter\"\n")->has_bus_statements(),
+          "bus statements");
+    check(std::strcmp(parse("chip \"fake-*\"\n    label temp1 \\\n        \"Continued\"\n")->label(chip, "temp1"),
+                      "Continued") == 0, "continued line");
+    check(std::strcmp(parse("chip \"fake-*\"\n    label temp1 \"A \\\"quoted\\\" label\"\n")->label(chip, "temp1"),
+                      "A \"quoted\" label") == 0, "escaped quotes");
+
+    // Malformed input, reported with its line number
+    check(fails_at("label temp1 \"CPU\"\n", 1), "label before chip");
+    check(fails_at("\nchip \"fake-*\"\n    ignore\n", 3), "missing name");
+    check(fails_at("chip \"fake-*\"\n    label temp1 \"CPU\n", 2), "unterminated string");
+    check(fails_at("chip \"fake-*\"\n    compute temp1 @ * 2 @ / 2\n", 2), "missing comma");
+    check(fails_at("chip \"fake-*\"\n    compute temp1 (@ * 2, @ / 2\n", 2), "missing parenthesis");
+    check(fails_at("chip \"fake-*\"\n    compute temp1 @ * , @ / 2\n", 2), "missing operand");
+    check(fails_at("chip \"fake-*\"\n    label temp1 \"CPU\" extra\n", 2), "trailing token");
+    check(fails_at("chip \"fake-*\"\n    label temp1 \"CPU\" ;\n", 2), "invalid character");
+    check(fails_at("chip \"fake-*\"\n\n    frobnicate temp1\n", 3), "unknown statement");
+    check(fails_at("bus \"isa\" \"ISA adapter\"\n", 1), "invalid bus name");
+    check(fails_at("chip\n", 1), "chip without a name");
+    check(!failure("# Only a comment\n\n"), "no statements");
+    return failures ? 1 : 0;
+}
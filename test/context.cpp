@@ -0,0 +1,174 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "sensors-c++/sensors.h"
+#include "sensors-c++/error.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sensors;
+namespace fs = std::filesystem;
+
+namespace {
+
+void write_file(fs::path const& path, std::string const& contents)
+{
+    std::ofstream{path} << contents;
+}
+
+std::string read_file(fs::path const& path)
+{
+    std::string contents;
+    std::ifstream{path} >> contents;
+    return contents;
+}
+
+std::optional<feature> find_feature(context const& ctx, std::string_view name)
+{
+    for (auto const& chip : ctx.get_detected_chips())
+        for (auto const& feat : chip.features())
+            if (feat.name() == name)
+                return feat;
+    return {};
+}
+
+double read_input(context const& ctx, std::string_view name)
+{
+    auto const feat = find_feature(ctx, name);
+    return feat ? feat->subfeature(subfeature_type::input)->read() : NAN;
+}
+
+} // anonymous namespace
+
+// Loads two native contexts with different configurations on a fake sysfs tree
+// and checks that each applies its own, also while readers of both run and one
+// of them is reloaded
+int main()
+{
+    char root_template[] = "/tmp/contexttest-XXXXXX";
+    fs::path const root {mkdtemp(root_template)};
+    auto const chip = root / "class/hwmon/hwmon0";
+    fs::create_directories(chip);
+    write_file(chip / "name", "fake\n");
+    write_file(chip / "temp1_input", "42000\n");
+    write_file(chip / "temp1_label", "Sensor\n");
+    write_file(chip / "temp2_input", "10000\n");
+    write_file(chip / "in0_input", "1000\n");
+    write_file(chip / "fan1_input", "1200\n");
+
+    auto const config_a = root / "a.conf";
+    write_file(config_a, "# Matches by prefix\n"
+                         "chip \"fake-*\"\n"
+                         "    label temp1 \"Context A\"\n"
+                         "    compute in0 @*2, @/2\n"
+                         "    ignore fan1\n");
+    auto const config_b = root / "b.conf";
+    write_file(config_b, "chip \"*-virtual-*\"\n"
+                         "    compute temp1 @+temp2_input, \\\n"
+                         "                  @-temp2_input\n"
+                         "chip \"other-*\"\n"
+                         "    label temp1 \"Not applied\"\n");
+    auto const config_bad = root / "bad.conf";
+    write_file(config_bad, "chip \"fake-*\"\n    compute in0 @*, @\n");
+
+    context a {backend::native, config_a.string(), root.string()};
+    context b {backend::native, config_b.string(), root.string()};
+
+    check(find_feature(a, "temp1")->label() == "Context A", "label statement");
+    check(find_feature(b, "temp1")->label() == "Sensor", "label attribute");
+    check(read_input(a, "in0") == 2, "compute statement");
+    check(read_input(b, "in0") == 1, "no compute statement");
+    check(read_input(b, "temp1") == 52, "compute statement with variable");
+    check(!find_feature(a, "fan1"), "ignore statement");
+    check(find_feature(b, "fan1").has_value(), "no ignore statement");
+
+    find_feature(a, "in0")->subfeature(subfeature_type::input)->write(3);
+    check(read_file(chip / "in0_input") == "1500", "compute statement on write");
+    find_feature(b, "temp1")->subfeature(subfeature_type::input)->write(60);
+    check(read_file(chip / "temp1_input") == "50000", "compute statement with variable on write");
+
+    try {
+        context bad {backend::native, config_bad.string(), root.string()};
+        check(false, "syntax error");
+    } catch (init_error const& e) {
+        std::cout << "Expected error: " << e.what() << '\n';
+    }
+
+    // A failed reload keeps the current generation in use
+    auto const kept = find_feature(a, "in0");
+    try {
+        a.load_config(config_bad.string());
+        check(false, "reload with syntax error");
+    } catch (init_error const&) {
+    }
+    check(kept && !kept->stale(), "generation kept after failed reload");
+    check(find_feature(a, "temp1")->label() == "Context A", "label after failed reload");
+    check(kept->subfeature(subfeature_type::input)->read() == 3, "read after failed reload");
+
+    // libsensors can be used by one context only, which is the default one here
+    try {
+        default_context();
+        try {
+            context other {backend::libsensors};
+            check(false, "second libsensors context");
+        } catch (init_error const&) {
+        }
+    } catch (init_error const& e) {
+        std::cout << "libsensors unavailable: " << e.what() << '\n';
+    }
+
+    // Reload a while the readers of b keep their configuration
+    std::atomic<bool> done {false};
+    std::vector<std::thread> readers;
+    for (auto ctx : {&a, &b}) {
+        readers.emplace_back([&, ctx]{
+            while (!done) {
+                read_lock const lock {*ctx};
+                for (auto const& c : ctx->get_detected_chips())
+                    for (auto const& feat : c.features())
+                        feat.label();
+            }
+        });
+    }
+    {
+        // A lock on another context does not keep a from reloading
+        read_lock const lock {b};
+        for (unsigned i = 0; i < 100; ++i)
+            a.load_config((i % 2 ? config_b : config_a).string());
+    }
+    done = true;
+    for (auto& t : readers)
+        t.join();
+    check(find_feature(a, "temp1")->label() == "Sensor", "reloaded configuration");
+    check(read_input(b, "temp1") == 60, "configuration of other context");
+
+    fs::remove_all(root);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/coroutine.h"
+#include "sensors-c++/error.h"
+
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace sensors;
+
+namespace {
+
+// A coroutine that starts right away and is not waited for
+struct task
+{
+    struct promise_type
+    {
+        task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+task read_one(async_reader& reader, subfeature sub, std::promise<std::pair<double, std::thread::id>>& result)
+{
+    auto const value = co_await async_read(reader, sub);
+    result.set_value({value, std::this_thread::get_id()});
+}
+
+task read_missing(async_reader& reader, subfeature sub, std::promise<std::error_code>& result)
+{
+    bool threw = false;
+    try {
+        co_await async_read(reader, sub);
+    } catch (io_error const&) {
+        threw = true;
+    }
+    double value = -1;
+    auto const error = co_await async_try_read(reader, sub, value);
+    result.set_value(threw && value == -1 ? error : std::error_code{});
+}
+
+task read_batch(async_reader& reader, std::vector<subfeature> const& subs, std::vector<double>& values,
+        std::vector<int>& errors, std::promise<void>& done)
+{
+    co_await async_read(reader, subs.data(), subs.size(), values.data(), errors.data());
+    co_await async_read(reader, subs.data(), 0, values.data());
+    done.set_value();
+}
+
+task count_reads(async_reader& reader, subfeature sub, double expected, std::atomic<int>& count)
+{
+    // Not in the condition itself, where GCC 12 destroys the awaitable early
+    auto const value = co_await async_read(reader, sub);
+    if (value == expected)
+        ++count;
+}
+
+} // anonymous namespace
+
+// Checks that awaited reads, single and batched, give the values and errors of
+// blocking ones and resume on a thread of the reader
+int main()
+{
+    fake_hwmon::layout l;
+    l.chips = 4;
+    fake_hwmon const tree {l};
+    context const ctx {backend::native, {}, tree.root()};
+    std::vector<subfeature> inputs;
+    for (auto const& chip : ctx.get_detected_chips())
+        for (auto const& feat : chip.features())
+            inputs.push_back(*feat.subfeature(subfeature_type::input));
+
+    for (auto engine : {read_engine::sync, read_engine::io_uring}) {
+        async_reader reader {engine};
+
+        std::promise<std::pair<double, std::thread::id>> one;
+        read_one(reader, inputs[3], one);
+        auto const [value, thread] = one.get_future().get();
+        check(value == inputs[3].read(), "value");
+        check(thread != std::this_thread::get_id(), "resumed on the reader");
+
+        std::vector<double> values(inputs.size(), -1);
+        std::vector<int> errors(inputs.size(), 1);
+        std::promise<void> batch;
+        read_batch(reader, inputs, values, errors, batch);
+        batch.get_future().get();
+        bool all = true;
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+            all = all && values[i] == inputs[i].read() && !errors[i];
+        check(all, "batch");
+
+        std::atomic<int> count {0};
+        for (int i = 0; i < 1000; ++i)
+            count_reads(reader, inputs[i % inputs.size()], inputs[i % inputs.size()].read(), count);
+        for (int i = 0; i < 1000 && count < 1000; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        check(count == 1000, "concurrent reads");
+    }
+
+    // A subfeature whose file is gone before it is first read
+    subfeature const missing {ctx, tree.chip_path(0) + "/in0_max"};
+    std::remove((tree.chip_path(0) + "/in0_max").c_str());
+    async_reader reader;
+    std::promise<std::error_code> error;
+    read_missing(reader, missing, error);
+    check(error.get_future().get() == errc::kernel, "missing file");
+    return failures ? 1 : 0;
+}
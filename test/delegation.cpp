@@ -0,0 +1,168 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "config.h"
+#include "impl.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+using namespace sensors;
+namespace fs = std::filesystem;
+
+namespace {
+
+// One chip with the features temp1 and in0, which have an input each, as
+// libsensors would report them
+class fake_enumeration : public enumeration
+{
+public:
+    fake_enumeration(std::string const& path, short bus_type)
+        : m_path{path}
+    {
+        m_chip.prefix = const_cast<char*>("fake");
+        m_chip.bus = {bus_type, 0};
+        m_chip.addr = 0x2d;
+        m_chip.path = m_path.data();
+
+        char const* const names[] = {"temp1", "in0"};
+        sensors_feature_type const types[] = {SENSORS_FEATURE_TEMP, SENSORS_FEATURE_IN};
+        char const* const inputs[] = {"temp1_input", "in0_input"};
+        sensors_subfeature_type const input_types[] = {SENSORS_SUBFEATURE_TEMP_INPUT, SENSORS_SUBFEATURE_IN_INPUT};
+        for (int i = 0; i < 2; ++i) {
+            m_features[i] = {};
+            m_features[i].name = const_cast<char*>(names[i]);
+            m_features[i].number = i;
+            m_features[i].type = types[i];
+            m_features[i].first_subfeature = i;
+            m_subfeatures[i] = {};
+            m_subfeatures[i].name = const_cast<char*>(inputs[i]);
+            m_subfeatures[i].number = i;
+            m_subfeatures[i].type = input_types[i];
+            m_subfeatures[i].flags = SENSORS_MODE_R | SENSORS_COMPUTE_MAPPING;
+        }
+    }
+
+    sensors_chip_name const* chip(int& nr) const override
+    {
+        return nr++ == 0 ? &m_chip : nullptr;
+    }
+
+    sensors_feature const* feature(sensors_chip_name const&, int& nr) const override
+    {
+        return nr < 2 ? &m_features[nr++] : nullptr;
+    }
+
+    sensors_subfeature const* subfeature(sensors_chip_name const&, sensors_feature const& feat,
+                                         int& nr) const override
+    {
+        return nr++ == 0 ? &m_subfeatures[feat.number] : nullptr;
+    }
+
+    std::string label(sensors_chip_name const&, sensors_feature const& feat) const override
+    {
+        return feat.name;
+    }
+
+private:
+    std::string m_path;
+    sensors_chip_name m_chip {};
+    sensors_feature m_features[2];
+    sensors_subfeature m_subfeatures[2];
+};
+
+std::shared_ptr<config const> parse(std::string const& text)
+{
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> const file {
+        fmemopen(const_cast<char*>(text.data()), text.size(), "r"), std::fclose};
+    return std::make_shared<config const>(file.get());
+}
+
+// Whether the libsensors backend reads the inputs of temp1 and in0 through
+// their own descriptors, rather than through sensors_get_value()
+struct direct
+{
+    bool temp1;
+    bool in0;
+};
+
+direct reads(std::string const& path, std::shared_ptr<config const> config, bool configured,
+             short bus_type = SENSORS_BUS_TYPE_VIRTUAL)
+{
+    auto const topology = topology::create(fake_enumeration{path, bus_type}, backend::libsensors, {},
+                                           std::move(config), configured);
+    auto const& chip = topology->chips()[0];
+    direct const result {chip.m_features[0].m_subfeatures[0].m_attribute.fd() >= 0,
+                         chip.m_features[1].m_subfeatures[0].m_attribute.fd() >= 0};
+    return result;
+}
+
+} // anonymous namespace
+
+// Checks that with a libsensors configuration, only the subfeatures of
+// features that a compute statement applies to are read through libsensors,
+// and those of all other features through their sysfs files
+int main()
+{
+    char root_template[] = "/tmp/delegationtest-XXXXXX";
+    fs::path const root {mkdtemp(root_template)};
+    std::ofstream{root / "temp1_input"} << "42000\n";
+    std::ofstream{root / "in0_input"} << "1000\n";
+    auto const path = root.string();
+
+    auto const computed = parse("chip \"fake-*\"\n    compute temp1 @*2, @/2\n");
+    auto result = reads(path, computed, true);
+    check(!result.temp1, "feature with a compute statement read through libsensors");
+    check(result.in0, "feature without a compute statement read directly");
+
+    result = reads(path, parse("chip \"fake-*\"\n    label temp1 \"CPU\"\n    set in0_min 1\n"), true);
+    check(result.temp1 && result.in0, "configuration without compute statements read directly");
+
+    result = reads(path, parse("chip \"other-*\"\n    compute temp1 @*2, @/2\n"), true);
+    check(result.temp1 && result.in0, "compute statement of another chip");
+
+    result = reads(path, {}, false);
+    check(result.temp1 && result.in0, "no configuration read directly");
+
+    result = reads(path, {}, true);
+    check(!result.temp1 && !result.in0, "unparsed configuration read through libsensors");
+
+    auto const buses = parse("bus \"i2c-0\" \"SMBus adapter\"\nchip \"fake-i2c-0-2d\"\n"
+                             "    compute temp1 @*2, @/2\n");
+    result = reads(path, buses, true, SENSORS_BUS_TYPE_I2C);
+    check(!result.temp1 && !result.in0, "renumbered I2C chip read through libsensors");
+    result = reads(path, buses, true, SENSORS_BUS_TYPE_VIRTUAL);
+    check(result.temp1 && result.in0, "chip on another bus read directly");
+
+    // The direct reads still give the values sensors_get_value() would
+    auto const topology = topology::create(fake_enumeration{path, SENSORS_BUS_TYPE_VIRTUAL}, backend::libsensors,
+                                           {}, computed, true);
+    double value = 0;
+    check(!topology->chips()[0].m_features[1].m_subfeatures[0].m_attribute.read(value) && value == 1,
+          "direct read of in0");
+
+    fs::remove_all(root);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "fake_hwmon.h"
+#include "impl.h"
+#include "sensors-c++/error.h"
+#include "sensors-c++/sensors.h"
+#include <sensors/error.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace sensors;
+namespace fs = std::filesystem;
+
+// Checks that errors of try_read() and try_write() map to sensors::errc and
+// sensors_strerror(), leave the value alone, and are returned rather than
+// thrown however many contexts the thread has locked
+int main()
+{
+    auto const& category = libsensors_category();
+    check(std::strcmp(category.name(), "libsensors") == 0, "category name");
+    check(&make_error_code(errc::io).category() == &category, "category of errc");
+    std::pair<errc, int> const codes[] = {
+        {errc::wildcards, SENSORS_ERR_WILDCARDS}, {errc::no_entry, SENSORS_ERR_NO_ENTRY},
+        {errc::access_read, SENSORS_ERR_ACCESS_R}, {errc::kernel, SENSORS_ERR_KERNEL},
+        {errc::div_zero, SENSORS_ERR_DIV_ZERO}, {errc::chip_name, SENSORS_ERR_CHIP_NAME},
+        {errc::bus_name, SENSORS_ERR_BUS_NAME}, {errc::parse, SENSORS_ERR_PARSE},
+        {errc::access_write, SENSORS_ERR_ACCESS_W}, {errc::io, SENSORS_ERR_IO},
+        {errc::recursion, SENSORS_ERR_RECURSION}
+    };
+    bool mapped = true;
+    for (auto const& [code, value] : codes) {
+        std::error_code const error {value, category};
+        mapped = mapped && error == code && make_error_code(code) == error && error.value() == value
+            && error.message() == sensors_strerror(-value) && error != std::errc::io_error;
+    }
+    check(mapped, "errc values and messages");
+
+    fake_hwmon::layout l;
+    l.chips = 1;
+    l.labels = false;
+    fake_hwmon const tree {l};
+    auto const chip = tree.chip_path(0);
+    std::string const path = "errortest.conf";
+    std::ofstream{path} << "chip \"fake0-*\"\n    compute temp1 @/0, @*1\n";
+    fs::permissions(chip + "/in0_min", fs::perms::owner_read | fs::perms::group_read | fs::perms::others_read);
+    context const ctx {backend::native, path, tree.root()};
+    std::remove(path.c_str());
+
+    double value = 42;
+    check(subfeature{ctx, chip + "/temp1_input"}.try_read(value) == errc::div_zero && value == 42,
+          "compute error leaves the value");
+    subfeature const missing {ctx, chip + "/in0_max"};
+    std::remove((chip + "/in0_max").c_str());
+    check(missing.try_read(value) == errc::kernel && value == 42, "missing file");
+    check(subfeature{ctx, chip + "/in0_min"}.try_write(1) == errc::access_write, "read-only file");
+
+    // Out of descriptors the first time a file is read, which later reads retry
+    rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    auto const lowered = rlimit{256, limit.rlim_max};
+    ::setrlimit(RLIMIT_NOFILE, &lowered);
+    std::vector<int> descriptors;
+    for (int fd; (fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC)) >= 0;)
+        descriptors.push_back(fd);
+    auto const exhausted = errno == EMFILE;
+    subfeature const unopened {ctx, chip + "/in0_input"};
+    check(exhausted && unopened.try_read(value) == errc::kernel && value == 42, "out of descriptors");
+    for (auto fd : descriptors)
+        ::close(fd);
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    check(!unopened.try_read(value) && value == unopened.read(), "opened once descriptors are free");
+
+    // Lock as many contexts as a thread can, then read
+    std::deque<context> contexts;
+    std::deque<read_lock> locks;
+    for (int i = 0; i < 15; ++i)
+        locks.emplace_back(contexts.emplace_back(backend::native, "", tree.root()));
+    bool thrown = false;
+    try {
+        context const extra {backend::native, "", tree.root()};
+        read_lock const lock {extra};
+    } catch (std::logic_error const&) {
+        thrown = true;
+    }
+    check(thrown, "one lock too many");
+    subfeature const input {contexts.back(), chip + "/in0_input"};
+    check(!input.try_read(value) && value == input.read(), "read with every lock taken");
+    try {
+        libsensors_lock const lock;
+    } catch (std::logic_error const&) {
+        check(false, "libsensors locked with every lock taken");
+    }
+    return failures ? 1 : 0;
+}
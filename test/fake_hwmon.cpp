@@ -0,0 +1,151 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "fake_hwmon.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct feature_kind
+{
+    char const* prefix;
+    // Channel numbers of all types but in start at 1
+    unsigned first;
+    int value;
+    std::initializer_list<char const*> suffixes;
+};
+
+feature_kind const kinds[] = {
+    {"temp", 1, 40000, {"input", "max", "min", "crit", "crit_hyst", "max_hyst", "lcrit", "emergency", "lowest",
+                        "highest", "alarm", "min_alarm", "max_alarm", "crit_alarm", "fault", "type", "offset"}},
+    {"in", 0, 1200, {"input", "min", "max", "lcrit", "crit", "average", "lowest", "highest", "alarm", "min_alarm",
+                     "max_alarm"}},
+    {"fan", 1, 1500, {"input", "min", "max", "alarm", "fault", "div", "pulses", "min_alarm", "max_alarm", "beep"}},
+    {"power", 1, 15000000, {"average", "input", "cap", "max", "min", "crit", "alarm", "cap_alarm", "max_alarm",
+                            "average_interval"}},
+    {"curr", 1, 2000, {"input", "min", "max", "lcrit", "crit", "average", "lowest", "highest", "alarm",
+                       "min_alarm"}},
+};
+
+void write_file(fs::path const& path, std::string const& contents)
+{
+    std::ofstream file {path};
+    file << contents << '\n';
+    if (!file)
+        throw std::runtime_error{"Failed to write " + path.string()};
+}
+
+} // anonymous namespace
+
+fake_hwmon::fake_hwmon(layout const& l)
+    : m_remove{true}
+{
+    // Prefer memory like sysfs, which also keeps large trees quick to build
+    auto const dir = fs::is_directory("/dev/shm") ? fs::path{"/dev/shm"} : fs::temp_directory_path();
+    auto path = (dir / "fake-hwmon-XXXXXX").string();
+    if (!mkdtemp(path.data()))
+        throw std::runtime_error{"Failed to create a temporary directory"};
+    m_root = path;
+    try {
+        build(l);
+    } catch (...) {
+        fs::remove_all(m_root);
+        throw;
+    }
+}
+
+fake_hwmon::fake_hwmon(layout const& l, std::string root)
+    : m_root{std::move(root)}, m_remove{false}
+{
+    if (fs::exists(m_root))
+        throw std::runtime_error{m_root + " already exists"};
+    build(l);
+}
+
+fake_hwmon::~fake_hwmon()
+{
+    if (m_remove) {
+        std::error_code ignored;
+        fs::remove_all(m_root, ignored);
+    }
+}
+
+std::string fake_hwmon::chip_path(unsigned chip) const
+{
+    return m_root + "/class/hwmon/hwmon" + std::to_string(chip);
+}
+
+void fake_hwmon::build(layout const& l)
+{
+    fs::path const root {m_root};
+    for (char const* bus : {"i2c", "platform", "pci"})
+        fs::create_directories(root / "bus" / bus);
+    fs::create_directories(root / "class/hwmon");
+
+    for (unsigned c = 0; c < l.chips; ++c) {
+        fs::path const chip {chip_path(c)};
+        fs::create_directories(chip);
+        write_file(chip / "name", "fake" + std::to_string(c % 4));
+
+        // A device, except for virtual chips, whose subsystem gives the bus
+        std::string device, bus;
+        switch (c % 4) {
+        case 1:
+            device = std::to_string(c / 256) + "-00" + std::to_string(10 + c % 90);
+            bus = "i2c";
+            break;
+        case 2:
+            device = "fake.";
+            device += std::to_string(c);
+            bus = "platform";
+            break;
+        case 3:
+            device = "0000:00:" + std::to_string(c % 32) + '.' + std::to_string(c / 32 % 8);
+            bus = "pci";
+            break;
+        }
+        if (!device.empty()) {
+            auto const device_path = root / "devices" / ("hwmon" + std::to_string(c)) / device;
+            fs::create_directories(device_path);
+            fs::create_symlink(fs::relative(root / "bus" / bus, device_path), device_path / "subsystem");
+            fs::create_symlink(fs::relative(device_path, chip), chip / "device");
+        }
+
+        for (unsigned f = 0; f < l.features; ++f) {
+            auto const& kind = kinds[f % std::size(kinds)];
+            auto const name = kind.prefix + std::to_string(kind.first + f / std::size(kinds));
+            if (l.labels && f % 2 == 0)
+                write_file(chip / (name + "_label"), "Fake " + name);
+            auto const count = std::min<std::size_t>(l.subfeatures, kind.suffixes.size());
+            auto suffix = kind.suffixes.begin();
+            for (std::size_t s = 0; s < count; ++s, ++suffix)
+                write_file(chip / (name + '_' + *suffix), std::to_string(kind.value + c + f));
+            m_subfeatures += count;
+        }
+        m_features += l.features;
+    }
+}
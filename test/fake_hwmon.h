@@ -0,0 +1,73 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#ifndef LIBSENSORS_CPP_TEST_FAKE_HWMON_H
+#define LIBSENSORS_CPP_TEST_FAKE_HWMON_H
+
+#include <string>
+
+// A synthetic sysfs tree with a hwmon class, for tests and benchmarks that use
+// the native backend with it as sysfs root. Chips cycle through the virtual,
+// I2C, ISA (platform) and PCI buses, and features through the temp, in, fan,
+// power and curr types.
+class fake_hwmon
+{
+public:
+    struct layout
+    {
+        unsigned chips = 1;
+        unsigned features = 8;
+        // Per feature, at most as many as the type has, e.g. 10 for fans
+        unsigned subfeatures = 5;
+        // Whether every other feature gets a _label attribute
+        bool labels = true;
+    };
+
+    // Build the tree in a new temporary directory, in /dev/shm if it exists,
+    // which is removed again by the destructor
+    explicit fake_hwmon(layout const& l);
+
+    // Build the tree below root, which must not exist yet, and keep it
+    fake_hwmon(layout const& l, std::string root);
+
+    ~fake_hwmon();
+
+    fake_hwmon(fake_hwmon const&) = delete;
+    fake_hwmon& operator=(fake_hwmon const&) = delete;
+
+    std::string const& root() const { return m_root; }
+
+    // E.g. <root>/class/hwmon/hwmon0
+    std::string chip_path(unsigned chip) const;
+
+    // Total number of features and subfeatures the tree contains
+    unsigned feature_count() const { return m_features; }
+    unsigned subfeature_count() const { return m_subfeatures; }
+
+private:
+    void build(layout const& l);
+
+    std::string m_root;
+    bool m_remove;
+    unsigned m_features = 0;
+    unsigned m_subfeatures = 0;
+};
+
+#endif // LIBSENSORS_CPP_TEST_FAKE_HWMON_H
@@ -0,0 +1,52 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "fake_hwmon.h"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+// Build a synthetic hwmon tree to point the library at, e.g. with
+// SENSORS_CPP_SYSFS_ROOT
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 5) {
+        std::cerr << "Usage: " << argv[0] << " ROOT [CHIPS [FEATURES [SUBFEATURES]]]\n";
+        return 2;
+    }
+    fake_hwmon::layout l;
+    if (argc > 2)
+        l.chips = std::strtoul(argv[2], nullptr, 10);
+    if (argc > 3)
+        l.features = std::strtoul(argv[3], nullptr, 10);
+    if (argc > 4)
+        l.subfeatures = std::strtoul(argv[4], nullptr, 10);
+
+    try {
+        fake_hwmon const tree {l, argv[1]};
+        std::cout << l.chips << " chips, " << tree.feature_count() << " features, " << tree.subfeature_count()
+            << " subfeatures in " << tree.root() << '\n';
+    } catch (std::exception const& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "alloc_count.h"
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/history.h"
+#include "sensors-c++/sampler.h"
+#include "sensors-c++/snapshot.h"
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace sensors;
+using namespace std::chrono_literals;
+
+namespace {
+
+history::clock::time_point at(long seconds)
+{
+    return history::clock::time_point{std::chrono::seconds{seconds}};
+}
+
+} // anonymous namespace
+
+// Checks the ring buffer and its range queries against a linear search, and
+// that snapshots and samplers fill histories without allocating
+int main()
+{
+    history h {5};
+    for (int i = 0; i < 12; ++i)
+        h.push(at(i), i);
+    auto const all = h.all();
+    check(h.size() == 5 && all.size() == 5, "size when full");
+    check(all.first.size == 3 && all.second.size == 2, "wrapped segments");
+    check(h.value(0) == 7 && h.value(4) == 11 && h.time(0) == at(7), "oldest entries replaced");
+    check(h.range(at(8), at(10)).size() == 2 && h.range(at(8), at(10)).first.values[0] == 8, "range");
+    check(h.range(at(0), at(7)).empty() && h.range(at(12), at(20)).empty(), "ranges outside");
+    h.push(at(3), 12);
+    check(h.time(4) == at(11), "decreasing time");
+
+    // Random ranges over histories with repeated times, at every fill level
+    std::mt19937 random {42};
+    for (std::size_t capacity : {1, 2, 7, 64}) {
+        history r {capacity};
+        std::vector<std::pair<long, double>> all_pushed;
+        long t = 0;
+        for (int i = 0; i < 200; ++i) {
+            t += random() % 3;
+            r.push(at(t), i);
+            all_pushed.emplace_back(t, i);
+            auto const kept = std::vector(all_pushed.end() - std::min(all_pushed.size(), capacity), all_pushed.end());
+            long const from = random() % (t + 2), to = from + random() % 10;
+            std::vector<double> expected;
+            for (auto const& [time, value] : kept)
+                if (time >= from && time < to)
+                    expected.push_back(value);
+            std::vector<double> values(capacity);
+            auto const count = r.copy(at(from), at(to), nullptr, values.data());
+            values.resize(count);
+            if (values != expected) {
+                check(false, "random range");
+                break;
+            }
+        }
+    }
+
+    history newest {3};
+    newest.assign(h);
+    check(newest.size() == 3 && newest.value(0) == 10 && newest.value(2) == 12, "assign newest");
+
+    // Histories filled by a snapshot and a sampler
+    fake_hwmon::layout l;
+    l.chips = 2;
+    fake_hwmon const tree {l};
+    context const ctx {backend::native, {}, tree.root()};
+    std::vector<subfeature> inputs;
+    for (auto const& chip : ctx.get_detected_chips())
+        for (auto const& feat : chip.features())
+            inputs.push_back(*feat.subfeature(subfeature_type::input));
+
+    snapshot snap {inputs};
+    std::vector<std::unique_ptr<history>> histories;
+    for (std::size_t i = 0; i < snap.size(); ++i)
+        snap.attach(i, histories.emplace_back(std::make_unique<history>(600)).get());
+    snap.refresh();
+    auto const before = allocation_count();
+    for (int i = 0; i < 999; ++i)
+        snap.refresh();
+    check(allocation_count() == before, "no allocations while refreshing");
+    check(histories[0]->size() == 600 && histories[0]->value(599) == snap.values()[0], "snapshot history");
+
+    sampler s;
+    for (auto const& sub : inputs)
+        s.add(sub, 1ms, 100);
+    history copied {1000};
+    check(s.copy_history(0, copied) == 0, "empty sampler history");
+    s.start();
+    std::this_thread::sleep_for(20ms);
+    auto const sampling = allocation_count();
+    std::this_thread::sleep_for(20ms);
+    check(allocation_count() == sampling, "no allocations while sampling");
+    s.stop();
+    check(s.copy_history(1, copied) >= 10 && copied.value(0) == inputs[1].read(), "sampler history");
+    check(copied.time(copied.size() - 1) == s.latest(1).time, "sampler history time");
+    return failures ? 1 : 0;
+}
@@ -25,10 +25,11 @@
 
 using namespace sensors;
 
-// TODO: write proper tests
-int main()
+// Describes one subfeature, by default temp1_input of hwmon0. Set
+// SENSORS_CPP_SYSFS_ROOT to run it on a tree made by fakehwmon.
+int main(int argc, char* argv[])
 {
-    subfeature sub{"/sys/class/hwmon/hwmon0/temp1_input"};
+    subfeature sub{argc > 1 ? argv[1] : "/sys/class/hwmon/hwmon0/temp1_input"};
     auto feat = sub.feature();
     auto chip = feat.chip();
     std::cout << chip.bus().adapter_name() << "\n";
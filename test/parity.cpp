@@ -0,0 +1,137 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "sensors-c++/sensors.h"
+#include "sensors-c++/error.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace sensors;
+
+namespace {
+
+// Everything the API reports about the detected chips, one line per object
+std::vector<std::string> describe(std::vector<chip_name> const& chips)
+{
+    std::vector<std::string> lines;
+    for (auto const& chip : chips) {
+        std::ostringstream line;
+        line << chip.path() << ": " << chip.name() << " prefix " << chip.prefix() << " address " << chip.address()
+            << " bus " << static_cast<int>(chip.bus().type()) << '/' << chip.bus().nr()
+            << " adapter '" << chip.bus().adapter_name() << "'";
+        lines.push_back(line.str());
+        for (auto const& feat : chip.features()) {
+            line.str({});
+            line << "  " << feat.name() << " #" << feat.number() << " type " << static_cast<int>(feat.type())
+                << " label '" << feat.label() << "'";
+            lines.push_back(line.str());
+            for (auto const& sub : feat.subfeatures()) {
+                line.str({});
+                line << "    " << sub.name() << " #" << sub.number() << " type " << static_cast<int>(sub.type())
+                    << " flags " << sub.readable() << sub.writable() << sub.compute_mapping();
+                lines.push_back(line.str());
+            }
+        }
+    }
+    return lines;
+}
+
+} // anonymous namespace
+
+// Compares the native backend to libsensors on this system's hwmon devices.
+// Both load the same configuration file, with statements that the native
+// backend supports, so that they should report exactly the same objects and
+// values.
+int main()
+{
+    if (!std::filesystem::is_directory("/sys/class/hwmon")) {
+        std::cout << "No hwmon class in /sys, skipping\n";
+        return 77;
+    }
+
+    std::string const config = "paritytest.conf";
+    std::ofstream{config} << "chip \"*-*\"\n"
+                             "    label temp1 \"Parity test\"\n"
+                             "    compute in0 @*2+1, (@-1)/2\n"
+                             "    compute temp2 -@, -@\n"
+                             "    ignore fan1\n"
+                             "chip \"*-isa-*\" \"*-pci-*\"\n"
+                             "    compute temp1 @/2, @*2\n";
+
+    context native {backend::native, config};
+    auto const actual_chips = native.get_detected_chips();
+    auto const actual = describe(actual_chips);
+
+    load_config(config);
+    auto const expected_chips = get_detected_chips();
+    auto const expected = describe(expected_chips);
+    std::remove(config.c_str());
+
+    int failures = 0;
+    for (std::size_t i = 0; i < std::max(expected.size(), actual.size()); ++i) {
+        auto const& e = i < expected.size() ? expected[i] : "(none)";
+        auto const& a = i < actual.size() ? actual[i] : "(none)";
+        if (e != a) {
+            std::cout << "libsensors: " << e << "\nnative:     " << a << '\n';
+            ++failures;
+        }
+    }
+    if (failures)
+        return 1;
+
+    // Values may change between reads, so the libsensors one must lie between
+    // two native ones
+    std::size_t values = 0;
+    for (std::size_t c = 0; c < actual_chips.size(); ++c) {
+        auto const expected_features = expected_chips[c].features();
+        auto const actual_features = actual_chips[c].features();
+        for (std::size_t f = 0; f < actual_features.size(); ++f) {
+            auto const expected_subs = expected_features[f].subfeatures();
+            auto const actual_subs = actual_features[f].subfeatures();
+            for (std::size_t s = 0; s < actual_subs.size(); ++s) {
+                double before = 0, value = 0, after = 0;
+                auto const error_before = actual_subs[s].try_read(before);
+                auto const error = expected_subs[s].try_read(value);
+                auto const error_after = actual_subs[s].try_read(after);
+                if (error != error_before && error != error_after) {
+                    std::cout << actual_subs[s].name() << ": libsensors error '" << error.message()
+                        << "', native error '" << error_before.message() << "'\n";
+                    ++failures;
+                } else if (!error && (value < std::min(before, after) || value > std::max(before, after))) {
+                    std::cout << actual_subs[s].name() << ": libsensors value " << value << ", native values "
+                        << before << " and " << after << '\n';
+                    ++failures;
+                }
+                ++values;
+            }
+        }
+    }
+
+    std::cout << actual_chips.size() << " chips, " << actual.size() - actual_chips.size() << " features and subfeatures, "
+        << values << " values compared, " << failures << " mismatches\n";
+    return failures ? 1 : 0;
+}
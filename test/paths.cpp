@@ -0,0 +1,81 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/sensors.h"
+#include "sensors-c++/error.h"
+
+#include <string>
+
+using namespace sensors;
+
+namespace {
+
+template<typename T, typename... Args>
+bool not_found(Args const&... args)
+{
+    try {
+        T{args...};
+        return false;
+    } catch (parse_error const&) {
+        return true;
+    }
+}
+
+} // anonymous namespace
+
+// Checks that the path constructors resolve paths of which one is a prefix of
+// another, like hwmon1/temp1 and hwmon10/temp10, to their own records. With 11
+// chips of 50 features, hwmon1 to hwmon10 each have temp1 to temp10.
+int main()
+{
+    fake_hwmon::layout l;
+    l.chips = 11;
+    l.features = 50;
+    l.subfeatures = 2;
+    l.labels = false;
+    fake_hwmon const tree {l};
+    context const ctx {backend::native, {}, tree.root()};
+    auto const hwmon1 = tree.chip_path(1), hwmon10 = tree.chip_path(10);
+
+    // temp1 and temp10 are features 0 and 45, which the tree gives the values
+    // 40000 plus the chip and feature number
+    subfeature const temp1 {ctx, hwmon1 + "/temp1_input"};
+    subfeature const temp10 {ctx, hwmon10 + "/temp10_input"};
+    check(temp1.feature().chip().path() == hwmon1 && temp1.feature().name() == "temp1"
+              && temp1.read() == 40.001, "hwmon1/temp1_input");
+    check(temp10.feature().chip().path() == hwmon10 && temp10.feature().name() == "temp10"
+              && temp10.read() == 40.055, "hwmon10/temp10_input");
+    check(subfeature{ctx, hwmon1 + "/temp10_input"}.read() == 40.046, "hwmon1/temp10_input");
+    check(subfeature{ctx, hwmon10 + "/temp1_input"}.read() == 40.010, "hwmon10/temp1_input");
+
+    check(feature{ctx, hwmon1, "temp10"}.chip().path() == hwmon1, "temp10 of hwmon1");
+    check(feature{ctx, hwmon10, "temp1"}.chip().path() == hwmon10, "temp1 of hwmon10");
+    check(feature{ctx, hwmon1 + "/temp1"}.subfeature(subfeature_type::input)->read() == 40.001, "hwmon1/temp1");
+    check(chip_name{ctx, hwmon10}.path() == hwmon10 && chip_name{ctx, hwmon1}.path() == hwmon1, "chips");
+
+    // Prefixes of existing paths are not paths themselves
+    check(not_found<chip_name>(ctx, hwmon1.substr(0, hwmon1.size() - 1)), "prefix of a chip path");
+    check(not_found<feature>(ctx, hwmon1 + "/temp"), "prefix of a feature");
+    check(not_found<subfeature>(ctx, hwmon10 + "/temp1_in"), "prefix of a subfeature");
+    check(not_found<subfeature>(ctx, hwmon1 + "0/temp1_input0"), "extended path");
+    return failures ? 1 : 0;
+}
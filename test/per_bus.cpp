@@ -0,0 +1,79 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "alloc_count.h"
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/snapshot.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace sensors;
+
+// Checks that reading each bus on its own thread gives the results of reading
+// them one after another, also after the snapshot has been moved
+int main()
+{
+    fake_hwmon::layout l;
+    l.chips = 8;
+    fake_hwmon const tree {l};
+    context const ctx {backend::native, {}, tree.root()};
+    std::vector<subfeature> readable, virtual_only;
+    for (auto const& chip : ctx.get_detected_chips())
+        for (auto const& feat : chip.features())
+            for (auto const& sub : feat.subfeatures())
+                if (sub.readable()) {
+                    readable.push_back(sub);
+                    if (chip.bus().type() == bus_type::virt)
+                        virtual_only.push_back(sub);
+                }
+
+    snapshot sync {readable};
+    snapshot per_bus {readable, read_engine::per_bus};
+    check(per_bus.engine() == read_engine::per_bus, "engine");
+    check(snapshot{virtual_only, read_engine::per_bus}.engine() == read_engine::sync, "one bus");
+
+    sync.refresh();
+    per_bus.refresh();
+    check(per_bus.values() == sync.values() && per_bus.errors() == sync.errors(), "same results");
+    auto const before = allocation_count();
+    for (int i = 0; i < 100; ++i)
+        per_bus.refresh();
+    check(allocation_count() == before, "no allocations");
+    check(per_bus.times()[0] > sync.times().back(), "read times");
+
+    // The workers keep writing to the same arrays after a move
+    std::size_t changed = 0;
+    while (readable[changed].name() != "temp1_input")
+        ++changed;
+    std::ofstream{std::string{readable[changed].feature().chip().path()} + "/temp1_input"} << 12345;
+    snapshot moved {std::move(per_bus)};
+    moved.refresh();
+    check(moved.values()[changed] == 12.345, "moved");
+    for (std::size_t i = 0; i < readable.size(); ++i)
+        if (i != changed && (moved.values()[i] != sync.values()[i] || moved.errors()[i])) {
+            check(false, "moved values");
+            break;
+        }
+    return failures ? 1 : 0;
+}
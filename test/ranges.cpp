@@ -0,0 +1,85 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "alloc_count.h"
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/sensors.h"
+
+#include <algorithm>
+#include <iostream>
+#include <ranges>
+#include <string>
+#include <vector>
+
+using namespace sensors;
+
+static_assert(std::ranges::forward_range<object_range<chip_name>>);
+static_assert(std::ranges::sized_range<object_range<feature>>);
+static_assert(std::ranges::viewable_range<object_range<subfeature>>);
+
+// Composes the ranges of a synthetic tree with views and checks that they stop
+// early, make no allocations and keep their configuration alive
+int main()
+{
+    fake_hwmon::layout l;
+    l.chips = 8;
+    fake_hwmon const tree {l};
+    context ctx {backend::native, {}, tree.root()};
+
+    auto const is_fan = [](feature const& f) { return f.type() == feature_type::fan; };
+    auto const chips = ctx.detected_chips();
+    check(chips.size() == l.chips, "chip count");
+
+    // The first fan of every chip, which is its third feature; take() increments
+    // past it, which finds the second right after
+    unsigned tested = 0;
+    auto const counted = [&](feature const& f) { ++tested; return is_fan(f); };
+    auto const before = allocation_count();
+    unsigned fans = 0;
+    for (auto const& chip : chips)
+        for (auto const& fan : chip.feature_range() | std::views::filter(counted) | std::views::take(1))
+            fans += fan.name() == "fan1";
+    check(allocation_count() == before, "no allocations");
+    check(fans == l.chips, "first match");
+    check(tested == 4 * l.chips, "early exit");
+
+    // Nested views over all subfeatures
+    auto inputs = chips
+        | std::views::transform([](chip_name const& c) { return c.feature_range(); })
+        | std::views::join
+        | std::views::transform([](feature const& f) { return f.subfeature(subfeature_type::input); })
+        | std::views::filter([](auto const& sub) { return sub.has_value(); });
+    check(std::ranges::distance(inputs) == tree.feature_count(), "joined inputs");
+
+    std::vector<feature> const features = chips.front().feature_range();
+    check(features.size() == l.features && features.back().name() == chips.front().feature_range()[l.features - 1].name(),
+          "conversion to vector");
+    check(ctx.get_detected_chips().size() == chips.size() && chips.front().features().size() == l.features,
+          "vector overloads");
+
+    // A range outlives the configuration it was obtained from
+    auto const old = chips.front().feature_range();
+    ctx.select_backend(backend::native, tree.root());
+    check(old.front().stale(), "stale range");
+    check(std::ranges::count_if(old, is_fan) == std::ranges::count_if(ctx.detected_chips().front().feature_range(), is_fan),
+          "stale range contents");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "alloc_count.h"
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/sampler.h"
+
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+using namespace sensors;
+using namespace std::chrono_literals;
+
+namespace {
+
+bool readable(int fd, std::chrono::milliseconds timeout)
+{
+    pollfd p {fd, POLLIN, 0};
+    return ::poll(&p, 1, static_cast<int>(timeout.count())) == 1;
+}
+
+} // anonymous namespace
+
+// Checks that fd() and drain() return new samples, of the background thread
+// and with caller threading, as an event loop would use them
+int main()
+{
+    fake_hwmon::layout l;
+    l.chips = 2;
+    fake_hwmon const tree {l};
+    context const ctx {backend::native, {}, tree.root()};
+    std::vector<subfeature> inputs;
+    for (auto const& chip : ctx.get_detected_chips())
+        for (auto const& feat : chip.features())
+            inputs.push_back(*feat.subfeature(subfeature_type::input));
+
+    std::vector<sampler::update> updates;
+    updates.reserve(inputs.size());
+
+    sampler background;
+    for (auto const& sub : inputs)
+        background.add(sub, 2ms);
+    check(!readable(background.fd(), 0ms) && background.drain(updates) == 0, "nothing before start");
+    background.start();
+    check(readable(background.fd(), 1000ms), "readable after a sweep");
+    check(background.drain(updates) > 0 && updates[0].value == inputs[updates[0].index].read(), "drained");
+    std::set<std::size_t> indices;
+    for (int i = 0; i < 10 && indices.size() < inputs.size(); ++i) {
+        readable(background.fd(), 1000ms);
+        background.drain(updates);
+        for (auto const& u : updates)
+            indices.insert(u.index);
+    }
+    check(indices.size() == inputs.size(), "all subfeatures drained");
+    background.stop();
+    background.drain(updates);
+    check(background.drain(updates) == 0, "nothing new after stop");
+
+    // Subfeature 0 every 5 ms, the others every second
+    sampler caller;
+    for (std::size_t i = 0; i < inputs.size(); ++i)
+        caller.add(inputs[i], i ? 1000ms : 5ms);
+    caller.start(sampler::threading::caller);
+    check(readable(caller.fd(), 0ms), "due right away");
+    check(caller.drain(updates) == inputs.size(), "first samples");
+    check(!readable(caller.fd(), 0ms) && caller.drain(updates) == 0, "nothing due");
+
+    // Only lower bounds on the number of samples, which depends on scheduling.
+    // Every sweep reads subfeature 0, the earliest due, and a late one counts
+    // as a deadline miss instead of taking the skipped samples.
+    auto const before = allocation_count();
+    auto const started = sampler::clock::now();
+    std::size_t zero = 0, other = 0;
+    auto last = updates[0].time;
+    bool ordered = true;
+    for (auto const end = started + 100ms; sampler::clock::now() < end;) {
+        if (!readable(caller.fd(), 1000ms))
+            break;
+        caller.drain(updates);
+        for (auto const& u : updates) {
+            if (u.index) {
+                ++other;
+            } else {
+                ++zero;
+                ordered = ordered && u.time > last;
+                last = u.time;
+            }
+        }
+    }
+    auto const elapsed = sampler::clock::now() - started;
+    auto const stats = caller.stats();
+    check(allocation_count() == before, "no allocations while draining");
+    check(zero >= 5 && ordered, "samples when due");
+    check(other == 0 || elapsed >= 1000ms, "nothing before its period");
+    check(stats.sweeps == zero + 1, "sweeps in drain()");
+    check(stats.deadline_misses <= inputs.size() + zero + other, "at most one miss per sample");
+    caller.stop();
+    check(!readable(caller.fd(), 20ms) && caller.drain(updates) == 0, "stopped");
+
+    // A sweep that runs past the next deadline, here because drain() is late,
+    // takes one sample and counts a miss. The periods it missed are skipped:
+    // the next deadline stays in phase with the start.
+    sampler late;
+    late.add(inputs[0], 10ms);
+    auto const late_start = sampler::clock::now();
+    late.start(sampler::threading::caller);
+    late.drain(updates);
+    auto const misses = late.stats().deadline_misses;
+    std::this_thread::sleep_for(35ms);
+    check(late.drain(updates) == 1 && late.stats().deadline_misses == misses + 1, "deadline miss counted");
+    auto const missed = updates.at(0).time;
+    check(readable(late.fd(), 1000ms) && late.drain(updates) == 1 && updates[0].time > missed
+              && updates[0].time - late_start >= 40ms, "missed periods skipped");
+    late.stop();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/sensors.h"
+#include "sensors-c++/error.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+using namespace sensors;
+
+// Enumerates a synthetic tree of 500 chips with 40 attributes each and checks
+// that the native backend finds all of it
+int main()
+{
+    fake_hwmon::layout l;
+    l.chips = 500;
+    l.features = 8;
+    l.subfeatures = 5;
+    fake_hwmon const tree {l};
+    context const ctx {backend::native, {}, tree.root()};
+
+    auto const chips = ctx.get_detected_chips();
+    unsigned features = 0, subfeatures = 0;
+    int buses[4] {};
+    for (auto const& chip : chips) {
+        switch (chip.bus().type()) {
+        case bus_type::virt: ++buses[0]; break;
+        case bus_type::i2c: ++buses[1]; break;
+        case bus_type::isa: ++buses[2]; break;
+        case bus_type::pci: ++buses[3]; break;
+        default: break;
+        }
+        for (auto const& feat : chip.features()) {
+            ++features;
+            subfeatures += feat.subfeatures().size();
+        }
+    }
+    check(chips.size() == l.chips, "chip count " + std::to_string(chips.size()));
+    check(features == tree.feature_count(), "feature count " + std::to_string(features));
+    check(subfeatures == tree.subfeature_count(), "subfeature count " + std::to_string(subfeatures));
+    for (auto count : buses)
+        check(count == 125, "chips per bus type " + std::to_string(count));
+
+    // Only the chips of one kind
+    check(ctx.get_detected_chips(chip_pattern{"fake3-*"}).size() == 125, "chips matching a prefix");
+    check(ctx.get_detected_chips(chip_pattern{"*-isa-*"}).size() == 125, "chips matching a bus type");
+    check(ctx.get_detected_chips({}, bus_type::pci).size() == 125, "chips on a bus type");
+    check(ctx.get_detected_chips(chip_pattern{"fake2-*"}, bus_type::isa).size() == 125, "pattern and bus type");
+    check(ctx.get_detected_chips(chip_pattern{"fake2-*"}, bus_type::pci).empty(), "pattern and other bus type");
+    // PCI addresses repeat in this tree
+    auto const addressed = ctx.get_detected_chips(chip_pattern{"fake3-pci-00cf"});
+    check(!addressed.empty() && std::all_of(addressed.begin(), addressed.end(), [](chip_name const& chip) {
+        return chip.name() == "fake3-pci-00cf" && chip_pattern{"*-pci-*"}(chip);
+    }), "chips matching an address");
+    try {
+        chip_pattern{"fake3-pci-*-*"};
+        check(false, "invalid pattern");
+    } catch (parse_error const&) {
+    }
+
+    // The last chip, by path
+    subfeature const sub {ctx, tree.chip_path(499) + "/temp1_max"};
+    check(sub.read() == (40000 + 499) / 1000.0, "value of " + std::string{sub.name()});
+    check(sub.feature().label() == "Fake temp1", "label of " + std::string{sub.feature().name()});
+    check(sub.feature().chip().name() == "fake3-pci-00cf", "name of " + std::string{sub.feature().chip().path()});
+
+    std::cout << chips.size() << " chips, " << features << " features, " << subfeatures << " subfeatures\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * This file is part of the sensors-c++ library.
+ * Copyright (C) 2019  Steven Franzen <sfranzen85@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ */
+
+#include "check.h"
+#include "fake_hwmon.h"
+#include "sensors-c++/sensors.h"
+#include "sensors-c++/error.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sensors;
+
+namespace {
+
+struct result
+{
+    unsigned long sweeps;
+    unsigned long reads;
+    unsigned long stale_sweeps;
+    unsigned long mixed_sweeps;
+};
+
+// Reads every subfeature of ctx from several threads while the main thread
+// keeps switching between the configurations. Half of the readers hold a
+// read_lock for each sweep; the others keep their chips across reloads until
+// they become stale. Either way every label read in one sweep must come from
+// the same configuration.
+result run(context& ctx, std::string const (&configs)[2])
+{
+    std::atomic<bool> done {false};
+    std::atomic<unsigned long> sweeps {0}, reads {0}, stale_sweeps {0}, mixed_sweeps {0};
+    auto const sweep = [&](std::vector<chip_name> const& chips) {
+        std::string first_label;
+        bool mixed = false;
+        for (auto const& chip : chips) {
+            chip.name();
+            for (auto const& feat : chip.features()) {
+                auto const label = std::string{feat.label()};
+                if (feat.name() == "temp1") {
+                    if (first_label.empty())
+                        first_label = label;
+                    mixed |= label != first_label;
+                }
+                for (auto const& sub : feat.subfeatures()) {
+                    double value;
+                    if (sub.readable() && !sub.try_read(value))
+                        ++reads;
+                }
+            }
+        }
+        if (mixed)
+            ++mixed_sweeps;
+        ++sweeps;
+    };
+
+    std::vector<std::thread> readers;
+    auto const thread_count = std::max(4u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < thread_count; ++i) {
+        if (i % 2) {
+            readers.emplace_back([&]{
+                while (!done) {
+                    read_lock const lock {ctx};
+                    sweep(ctx.get_detected_chips());
+                }
+            });
+        } else {
+            readers.emplace_back([&]{
+                std::vector<chip_name> chips = ctx.get_detected_chips();
+                while (!done) {
+                    sweep(chips);
+                    if (!chips.empty() && chips.front().stale()) {
+                        ++stale_sweeps;
+                        chips = ctx.get_detected_chips();
+                    }
+                }
+            });
+        }
+    }
+
+    unsigned const reloads = 200;
+    for (unsigned i = 0; i < reloads; ++i)
+        ctx.load_config(configs[i % 2]);
+    done = true;
+    for (auto& t : readers)
+        t.join();
+
+    std::cout << thread_count << " threads, " << reloads << " reloads, " << sweeps << " sweeps, "
+        << reads << " values read, " << stale_sweeps << " stale sweeps\n";
+    return {sweeps, reads, stale_sweeps, mixed_sweeps};
+}
+
+} // anonymous namespace
+
+// Runs a native context on a synthetic tree, so that it does not depend on the
+// hwmon devices of the system or change the state of its default context.
+// Fails by crashing, hanging or throwing, or if nothing could be read or a sweep
+// saw more than one configuration.
+int main()
+{
+    // Two configuration files that label every chip's temp1 differently
+    std::string const labels[] = {"stresstest-a.conf", "stresstest-b.conf"};
+    std::ofstream{labels[0]} << "chip \"fake0-*\" \"fake1-*\" \"fake2-*\" \"fake3-*\"\n    label temp1 \"C\"\n";
+    std::ofstream{labels[1]} << "chip \"fake0-*\" \"fake1-*\" \"fake2-*\" \"fake3-*\"\n    label temp1 \"D\"\n";
+    fake_hwmon::layout l;
+    l.chips = 4;
+    fake_hwmon const tree {l};
+    context ctx {backend::native, labels[0], tree.root()};
+    auto const native = run(ctx, labels);
+    // The last reload loaded the second one
+    std::string last_label;
+    std::vector<chip_name> const chips = ctx.get_detected_chips();
+    for (auto const& feat : chips.front().features())
+        if (feat.name() == "temp1")
+            last_label = feat.label();
+
+    for (auto const& path : labels)
+        std::remove(path.c_str());
+
+    check(native.reads > 0, "values read from the synthetic tree");
+    check(last_label == "D", "labels of the configuration applied");
+    check(native.mixed_sweeps == 0, "every sweep saw one configuration");
+    return failures ? 1 : 0;
+}